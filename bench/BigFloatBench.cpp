@@ -0,0 +1,93 @@
+// Cost of one z = z^2 + c step in each number type the viewer iterates with. Build and run with make bench.
+#include <Complex.hpp>
+#include <DoubleDouble.hpp>
+#include <BigFloat.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace baseline;
+
+const int STEPS = 200000;
+
+// inside the period 3 bulb, so the orbit stays bounded and no type ends up iterating infinities
+const double CR = -0.12, CI = 0.74;
+
+template <typename F>
+void report(const char* name, int steps, F step) {
+      auto start = std::chrono::steady_clock::now();
+      double check = step(steps);
+      double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / steps;
+      std::cout << name << ": " << ns << " ns/step (" << check << ")\n";
+}
+
+template <typename T>
+double complexSteps(int steps, T cr, T ci) {
+      Complex<T> z, c(cr, ci);
+      for (int i = 0; i < steps; i++) {
+            z = z*z + c;
+      }
+      return double(z.R);
+}
+
+// the loop computeReference runs, with in place squaring on that many threads
+double referenceSteps(int steps, int bits, int threads) {
+      BigFloat cr(CR, bits), ci(CI, bits), zr(0.0, bits), zi(0.0, bits), zr2, zi2, t;
+      squaringTeam team(threads);
+      BigFloat* const squares[] = { &zr2, &zi2, &t };
+      const BigFloat* const roots[] = { &zr, &zi, &t };
+
+      for (int i = 0; i < steps; i++) {
+            BigFloat::add(t, zr, zi);
+            team.sqr(squares, roots, 3);
+            BigFloat::sub(t, t, zr2);
+            BigFloat::sub(t, t, zi2);
+            BigFloat::add(zi, t, ci);
+            BigFloat::sub(zr, zr2, zi2);
+            BigFloat::add(zr, zr, cr);
+      }
+      return double(zr);
+}
+
+int main() {
+      report("Complex<double>", STEPS, [](int n) { return complexSteps<double>(n, CR, CI); });
+      report("Complex<dd>", STEPS, [](int n) { return complexSteps<dd>(n, dd(CR), dd(CI)); });
+
+      for (int bits : { 128, 256, 512, 1024, 2048, 4096, 8192 }) {
+            std::string b = std::to_string(bits);
+            int steps = STEPS * 128 / bits;
+            report(("Complex<BigFloat> " + b).c_str(), steps, [&](int n) { return complexSteps<BigFloat>(n, BigFloat(CR, bits), BigFloat(CI, bits)); });
+            report(("BigFloat reference " + b).c_str(), steps, [&](int n) { return referenceSteps(n, bits, 1); });
+            report(("BigFloat parallel reference " + b).c_str(), steps, [&](int n) { return referenceSteps(n, bits, 3); });
+
+            BigFloat x(CI, bits), y(CR, bits), r;
+            x = x * y + BigFloat(CR, bits);
+            report(("BigFloat mul " + b).c_str(), steps, [&](int n) { for (int i = 0; i < n; i++) BigFloat::mul(r, x, x); return double(r); });
+            report(("BigFloat sqr " + b).c_str(), steps, [&](int n) { for (int i = 0; i < n; i++) BigFloat::sqr(r, x); return double(r); });
+      }
+
+      // Where the three thread reference loop starts beating one thread, which parallelReferenceBits should be.
+      // Best of several runs, the handoff being noisy.
+      int crossover = 0;
+      for (int bits : { 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096 }) {
+            auto best = [&](int threads) {
+                  int steps = STEPS * 32 / bits;
+                  double ns = 1e300;
+                  for (int run = 0; run < 5; run++) {
+                        auto start = std::chrono::steady_clock::now();
+                        referenceSteps(steps, bits, threads);
+                        ns = std::min(ns, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / steps);
+                  }
+                  return ns;
+            };
+            double one = best(1), three = best(3);
+            std::cout << "reference " << bits << ": 1 thread " << one << " ns/step, 3 threads " << three << " ns/step\n";
+            if (three < one && crossover == 0) crossover = bits;
+            if (three >= one) crossover = 0;
+      }
+      std::cout << "three threads pay from " << (crossover ? std::to_string(crossover) + " bits" : std::string("none of these")) << " on "
+            << std::thread::hardware_concurrency() << " cores\n";
+      return 0;
+}
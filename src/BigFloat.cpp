@@ -0,0 +1,413 @@
+#include <BigFloat.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <thread>
+
+typedef unsigned __int128 uint128;
+
+static int limbsFor(int bits) {
+      return std::max(BigFloat::MIN_BITS, bits + BigFloat::LIMB_BITS - 1) / BigFloat::LIMB_BITS;
+}
+
+static double scaled(uint64_t limb, int64_t exp) {
+      return std::ldexp((double)limb, (int)std::max<int64_t>(std::min<int64_t>(exp, INT_MAX), INT_MIN));
+}
+
+// Scratch space for an intermediate mantissa, on the stack up to 4096 bits so the hot loops do not allocate
+class scratch {
+      public:
+            scratch(int n): heap(n > STACK_LIMBS ? n : 0) {
+                  data = n > STACK_LIMBS ? heap.data() : stack;
+                  std::fill(data, data + n, 0);
+            }
+
+            uint64_t* data;
+
+      private:
+            static const int STACK_LIMBS = 64;
+            uint64_t stack[STACK_LIMBS];
+            std::vector<uint64_t> heap;
+};
+
+BigFloat::BigFloat(): limbs(MIN_BITS / LIMB_BITS, 0), exp(0), neg(false) {}
+
+BigFloat::BigFloat(double x): BigFloat(x, MIN_BITS) {}
+
+BigFloat::BigFloat(double x, int bits): limbs(limbsFor(bits), 0), exp(0), neg(false) {
+      if (x == 0 || !std::isfinite(x)) return;
+
+      int e;
+      double m = std::frexp(std::fabs(x), &e);
+      limbs.back() = (uint64_t)std::ldexp(m, LIMB_BITS);
+      exp = e;
+      neg = x < 0;
+}
+
+BigFloat::BigFloat(const floatExp& x, int bits): BigFloat(x.m, bits) {
+      scale(x.e);
+}
+
+BigFloat::BigFloat(const dd& x): BigFloat(BigFloat(x.hi) + BigFloat(x.lo)) {}
+
+void BigFloat::setPrecision(int bits) {
+      int n = limbsFor(bits), current = limbs.size();
+
+      if (n > current) {
+            limbs.insert(limbs.begin(), n - current, 0);
+      } else {
+            limbs.erase(limbs.begin(), limbs.begin() + (current - n));
+      }
+}
+
+BigFloat::operator double() const {
+      if (isZero()) return 0;
+
+      int n = limbs.size();
+      double x = scaled(limbs[n-1], exp - LIMB_BITS) + scaled(limbs[n-2], exp - 2*LIMB_BITS);
+      return neg ? -x : x;
+}
+
+BigFloat::operator dd() const {
+      double hi = double(*this);
+      return dd(hi, double(*this - BigFloat(hi, precision())));
+}
+
+BigFloat::operator floatExp() const {
+      if (isZero()) return floatExp();
+
+      int n = limbs.size();
+      double m = scaled(limbs[n-1], -LIMB_BITS) + scaled(limbs[n-2], -2*LIMB_BITS);
+      return floatExp(neg ? -m : m, exp);
+}
+
+// Normalizes the n limb magnitude m * 2^(exp - 64n) and truncates it to limbCount limbs in r
+void BigFloat::normalize(BigFloat& r, const uint64_t* m, int n, int64_t exp, bool neg, int limbCount) {
+      int top = n - 1;
+      while (top >= 0 && m[top] == 0) top--;
+
+      r.limbs.assign(limbCount, 0);
+      if (top < 0) {
+            r.exp = 0;
+            r.neg = false;
+            return;
+      }
+
+      int words = n - 1 - top, bits = __builtin_clzll(m[top]);
+      r.exp = exp - (int64_t)words*LIMB_BITS - bits;
+      r.neg = neg;
+
+      // limb k of m shifted left by words limbs and bits bits
+      auto shifted = [&](int k) -> uint64_t {
+            int j = k - words;
+            uint64_t hi = j >= 0 ? m[j] : 0, lo = j >= 1 ? m[j-1] : 0;
+            return bits ? (hi << bits) | (lo >> (LIMB_BITS - bits)) : hi;
+      };
+
+      for (int i = 0; i < limbCount; i++) {
+            int k = n - limbCount + i;
+            r.limbs[i] = k >= 0 ? shifted(k) : 0;
+      }
+}
+
+// -1, 0 or 1 comparing |a| and |b|, both nonzero
+static int compareMagnitudes(const std::vector<uint64_t>& a, int64_t ea, const std::vector<uint64_t>& b, int64_t eb) {
+      if (ea != eb) return ea < eb ? -1 : 1;
+
+      int na = a.size(), nb = b.size();
+      for (int k = 1; k <= std::max(na, nb); k++) {
+            uint64_t x = k <= na ? a[na-k] : 0, y = k <= nb ? b[nb-k] : 0;
+            if (x != y) return x < y ? -1 : 1;
+      }
+      return 0;
+}
+
+int compare(const BigFloat& a, const BigFloat& b) {
+      if (a.isZero() && b.isZero()) return 0;
+      if (a.isZero()) return b.neg ? 1 : -1;
+      if (b.isZero()) return a.neg ? -1 : 1;
+      if (a.neg != b.neg) return a.neg ? -1 : 1;
+
+      int c = compareMagnitudes(a.limbs, a.exp, b.limbs, b.exp);
+      return a.neg ? -c : c;
+}
+
+// a + b, or a - b when negateB. The smaller magnitude is shifted down to the larger one's exponent into
+// one guard limb below the result's precision, bits beyond that are dropped.
+void BigFloat::addSigned(BigFloat& r, const BigFloat& a, const BigFloat& b, bool negateB) {
+      int n = std::max(a.limbs.size(), b.limbs.size());
+      bool bneg = b.neg != negateB;
+
+      if (b.isZero() || a.isZero()) {
+            bool useA = b.isZero();
+            const BigFloat& x = useA ? a : b;
+            bool xneg = useA ? a.neg : bneg;
+            if (&r != &x) r.limbs = x.limbs;
+            r.exp = x.exp;
+            r.neg = xneg && !x.isZero();
+            r.setPrecision(n*LIMB_BITS);
+            return;
+      }
+
+      bool aLarger = compareMagnitudes(a.limbs, a.exp, b.limbs, b.exp) >= 0;
+      const BigFloat& big = aLarger ? a : b;
+      const BigFloat& small = aLarger ? b : a;
+      bool sign = aLarger ? a.neg : bneg;
+      bool subtract = a.neg != bneg;
+
+      // [0, n+1) holds the sum with its guard limb, n+1 catches the carry
+      int w = n + 1;
+      scratch work(w + 1);
+      uint64_t* m = work.data;
+
+      int nbig = big.limbs.size(), nsmall = small.limbs.size();
+      for (int j = 0; j < nbig; j++) m[w - nbig + j] = big.limbs[j];
+
+      int64_t shift = big.exp - small.exp;
+      if (shift < (int64_t)w*LIMB_BITS) {
+            int words = shift / LIMB_BITS, bits = shift % LIMB_BITS;
+
+            // limb k of small aligned to the top of w limbs
+            auto aligned = [&](int k) -> uint64_t {
+                  int j = k - (w - nsmall);
+                  return j >= 0 && j < nsmall ? small.limbs[j] : 0;
+            };
+
+            uint128 carry = 0;
+            for (int k = 0; k < w; k++) {
+                  uint64_t s = bits ? (aligned(k + words) >> bits) | (aligned(k + words + 1) << (LIMB_BITS - bits)) : aligned(k + words);
+
+                  if (subtract) {
+                        uint128 d = (uint128)m[k] - s - carry;
+                        m[k] = d;
+                        carry = (d >> 64) & 1;
+                  } else {
+                        uint128 t = (uint128)m[k] + s + carry;
+                        m[k] = t;
+                        carry = t >> 64;
+                  }
+            }
+            if (!subtract) m[w] = carry;
+      }
+
+      normalize(r, m, w + 1, big.exp + LIMB_BITS, sign, n);
+}
+
+void BigFloat::add(BigFloat& r, const BigFloat& a, const BigFloat& b) {
+      addSigned(r, a, b, false);
+}
+
+void BigFloat::sub(BigFloat& r, const BigFloat& a, const BigFloat& b) {
+      addSigned(r, a, b, true);
+}
+
+void BigFloat::mul(BigFloat& r, const BigFloat& a, const BigFloat& b) {
+      int na = a.limbs.size(), nb = b.limbs.size();
+      scratch work(na + nb);
+      uint64_t* p = work.data;
+
+      for (int i = 0; i < na; i++) {
+            uint128 carry = 0;
+            for (int j = 0; j < nb; j++) {
+                  uint128 t = (uint128)a.limbs[i]*b.limbs[j] + p[i+j] + carry;
+                  p[i+j] = t;
+                  carry = t >> 64;
+            }
+            p[i+nb] = carry;
+      }
+
+      normalize(r, p, na + nb, a.exp + b.exp, a.neg != b.neg, std::max(na, nb));
+}
+
+// Schoolbook x^2 into the 2n limbs at p, which start zeroed. The n(n-1)/2 cross products x_i x_j, i < j, are
+// summed once and doubled, then the squares x_i^2 added.
+static void squareLimbs(uint64_t* p, const uint64_t* x, int n) {
+      for (int i = 0; i < n; i++) {
+            uint128 carry = 0;
+            for (int j = i + 1; j < n; j++) {
+                  uint128 t = (uint128)x[i]*x[j] + p[i+j] + carry;
+                  p[i+j] = t;
+                  carry = t >> 64;
+            }
+            p[i+n] = carry;
+      }
+
+      // doubling shifts each limb's top bit into the next one
+      uint64_t carry = 0, shifted = 0;
+      for (int i = 0; i < n; i++) {
+            uint64_t p0 = (p[2*i] << 1) | shifted, p1 = (p[2*i+1] << 1) | (p[2*i] >> 63);
+            shifted = p[2*i+1] >> 63;
+
+            uint128 t = (uint128)x[i]*x[i];
+            uint128 lo = (uint128)p0 + (uint64_t)t + carry;
+            uint128 hi = (uint128)p1 + (uint64_t)(t >> 64) + (uint64_t)(lo >> 64);
+            p[2*i] = lo;
+            p[2*i+1] = hi;
+            carry = hi >> 64;
+      }
+}
+
+// r[0, n) += x[0, m), m <= n, carrying into the rest of r
+static void addLimbs(uint64_t* r, int n, const uint64_t* x, int m) {
+      uint128 carry = 0;
+      for (int i = 0; i < n && (i < m || carry); i++) {
+            uint128 t = (uint128)r[i] + (i < m ? x[i] : 0) + carry;
+            r[i] = t;
+            carry = t >> 64;
+      }
+}
+
+// r[0, n) -= x[0, m), m <= n, the result being known to be nonnegative
+static void subLimbs(uint64_t* r, int n, const uint64_t* x, int m) {
+      uint64_t borrow = 0;
+      for (int i = 0; i < n && (i < m || borrow); i++) {
+            uint128 d = (uint128)r[i] - (i < m ? x[i] : 0) - borrow;
+            r[i] = d;
+            borrow = (d >> 64) & 1;
+      }
+}
+
+// Below this many limbs schoolbook squaring beats splitting. By make bench's sqr lines 16 is too low, anything
+// from 24 to 96 within noise of each other.
+static const int KARATSUBA_LIMBS = 48;
+
+// Limbs of scratch karatsubaSquare needs for n limbs: each level keeps h + l and its square, 3(hi + 1) limbs,
+// while the level below reuses what follows.
+static int karatsubaScratch(int n) {
+      if (n < KARATSUBA_LIMBS) return 0;
+      int hi = n - n / 2;
+      return 3*(hi + 1) + karatsubaScratch(hi + 1);
+}
+
+// x^2 into the 2n zeroed limbs at p. With x = hB + l, x^2 = h^2 B^2 + ((h + l)^2 - h^2 - l^2) B + l^2, three
+// half size squares instead of four. s is karatsubaScratch(n) limbs of workspace.
+static void karatsubaSquare(uint64_t* p, const uint64_t* x, int n, uint64_t* s) {
+      if (n < KARATSUBA_LIMBS) {
+            squareLimbs(p, x, n);
+            return;
+      }
+
+      int lo = n / 2, hi = n - lo;
+
+      // h + l, one limb longer for the carry
+      uint64_t* sum = s;
+      std::copy(x + lo, x + n, sum);
+      sum[hi] = 0;
+      addLimbs(sum, hi + 1, x, lo);
+      int sumLimbs = sum[hi] ? hi + 1 : hi;
+
+      uint64_t* middle = s + hi + 1;
+      std::fill(middle, middle + 2*sumLimbs, 0);
+      uint64_t* below = s + 3*(hi + 1);
+      karatsubaSquare(middle, sum, sumLimbs, below);
+
+      karatsubaSquare(p, x, lo, below);
+      karatsubaSquare(p + 2*lo, x + lo, hi, below);
+
+      subLimbs(middle, 2*sumLimbs, p, 2*lo);
+      subLimbs(middle, 2*sumLimbs, p + 2*lo, 2*hi);
+      addLimbs(p + lo, 2*n - lo, middle, std::min(2*sumLimbs, 2*n - lo));
+}
+
+void BigFloat::sqr(BigFloat& r, const BigFloat& a) {
+      int n = a.limbs.size();
+      scratch work(2*n + karatsubaScratch(n));
+      karatsubaSquare(work.data, a.limbs.data(), n, work.data + 2*n);
+      normalize(r, work.data, 2*n, 2*a.exp, false, n);
+}
+
+BigFloat operator - (const BigFloat& a) {
+      BigFloat r = a;
+      r.neg = !a.neg && !a.isZero();
+      return r;
+}
+
+BigFloat operator + (const BigFloat& a, const BigFloat& b) {
+      BigFloat r;
+      BigFloat::add(r, a, b);
+      return r;
+}
+
+BigFloat operator - (const BigFloat& a, const BigFloat& b) {
+      BigFloat r;
+      BigFloat::sub(r, a, b);
+      return r;
+}
+
+BigFloat operator * (const BigFloat& a, const BigFloat& b) {
+      BigFloat r;
+      BigFloat::mul(r, a, b);
+      return r;
+}
+
+// powers of two, like the 2 in 2*zr*zi, only move the exponent
+BigFloat operator * (const BigFloat& a, double b) {
+      int e;
+      double m = std::frexp(b, &e);
+      if (m != 0.5 && m != -0.5) return a * BigFloat(b, a.precision());
+
+      BigFloat r = a;
+      r.scale(e - 1);
+      r.neg = (a.neg != (b < 0)) && !a.isZero();
+      return r;
+}
+
+// Spins this many times waiting on the other threads before yielding the core
+static const int SPINS_BEFORE_YIELD = 4096;
+
+template <typename F>
+static void spinUntil(F done) {
+      for (int spins = 0; !done(); spins++) {
+            if (spins >= SPINS_BEFORE_YIELD) std::this_thread::yield();
+      }
+}
+
+squaringTeam::squaringTeam(int _threads): results(NULL), operands(NULL), count(0), generation(0), pending(0), stopping(false) {
+      threads = std::max(1, std::min<int>(_threads, std::thread::hardware_concurrency()));
+      for (int thread = 1; thread < threads; thread++) {
+            helpers.emplace_back(&squaringTeam::help, this, thread);
+      }
+}
+
+squaringTeam::~squaringTeam() {
+      stopping = true;
+      generation++;
+      for (std::thread& helper : helpers) {
+            helper.join();
+      }
+}
+
+void squaringTeam::run(int thread) {
+      for (int k = thread; k < count; k += threads) {
+            BigFloat::sqr(*results[k], *operands[k]);
+      }
+}
+
+void squaringTeam::help(int thread) {
+      int seen = 0;
+
+      while (true) {
+            spinUntil([&]() { return generation.load(std::memory_order_acquire) != seen; });
+            if (stopping) return;
+            seen++;
+
+            run(thread);
+            pending.fetch_sub(1, std::memory_order_release);
+      }
+}
+
+void squaringTeam::sqr(BigFloat* const r[], const BigFloat* const a[], int n) {
+      results = r;
+      operands = a;
+      count = n;
+      if (threads == 1) {
+            run(0);
+            return;
+      }
+
+      pending.store(threads - 1, std::memory_order_relaxed);
+      generation.fetch_add(1, std::memory_order_release);
+
+      run(0);
+      spinUntil([&]() { return pending.load(std::memory_order_acquire) == 0; });
+}
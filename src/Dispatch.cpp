@@ -0,0 +1,28 @@
+#include <Dispatch.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static const kernelTable* selectKernels() {
+      const kernelTable* tables[] = { &avx512Kernels, &avx2Kernels, &sse2Kernels, &scalarKernels };
+
+      // override for testing, e.g. MANDELBROT_ISA=sse2
+      const char* forced = std::getenv("MANDELBROT_ISA");
+      if (forced != NULL) {
+            for (const kernelTable* table : tables) {
+                  if (std::strcmp(forced, table -> name) == 0) return table;
+            }
+            std::cout << "Unknown MANDELBROT_ISA " << forced << ", probing cpu\n";
+      }
+
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) return &avx512Kernels;
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return &avx2Kernels;
+      if (__builtin_cpu_supports("sse2")) return &sse2Kernels;
+      return &scalarKernels;
+}
+
+const kernelTable& kernels() {
+      static const kernelTable* table = selectKernels();
+      return *table;
+}
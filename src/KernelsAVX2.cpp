@@ -0,0 +1,4 @@
+#define KERNEL_ISA avx2
+#include <KernelTable.hpp>
+
+const kernelTable avx2Kernels = avx2::makeKernelTable("avx2");
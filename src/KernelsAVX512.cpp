@@ -0,0 +1,4 @@
+#define KERNEL_ISA avx512
+#include <KernelTable.hpp>
+
+const kernelTable avx512Kernels = avx512::makeKernelTable("avx512");
@@ -0,0 +1,4 @@
+#define KERNEL_ISA sse2
+#include <KernelTable.hpp>
+
+const kernelTable sse2Kernels = sse2::makeKernelTable("sse2");
@@ -0,0 +1,5 @@
+#define KERNEL_ISA scalar
+#define KERNEL_SCALAR
+#include <KernelTable.hpp>
+
+const kernelTable scalarKernels = scalar::makeKernelTable("scalar");
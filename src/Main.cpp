@@ -3,7 +3,24 @@
 #include <vector>
 #include <thread>
 #include <stdlib.h>
-#include <Complex.hpp>
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <Dispatch.hpp>
+#include <Kernels.hpp>
+#include <Perturbation.hpp>
+#include <Nucleus.hpp>
+#include <Certify.hpp>
+#include <BigFloat.hpp>
+#include <FloatExp.hpp>
+
+using namespace baseline; // scalar kernels built with the default flags
 
 const int THREAD_COUNT = 24;
 
@@ -13,21 +30,117 @@ enum fractalType {
       julia
 };
 
+// how deep zooms iterate their deltas, B switches between them
+enum deepZoomMethod {
+      perturbation,
+      bilinear
+};
+
+// which pixels of a frame get iterated, M cycles through them
+enum renderMethod {
+      everyPixel,
+      subdivision,
+      boundaryTracing
+};
+
+const int renderMethodN = 3;
+const char* renderMethodNames[] = { "every pixel", "Mariani-Silver subdivision", "boundary tracing" };
+
+struct renderSettings {
+      deepZoomMethod method = deepZoomMethod::bilinear;
+      bool rebase = true; // restart pixels at the start of the orbit instead of adding references, G toggles it
+      bool certify = false; // prove whole tiles escaping or bounded before iterating pixels, I toggles it
+      renderMethod render = renderMethod::everyPixel;
+};
+
+renderSettings settings;
+
+// cheapest arithmetic that still resolves neighbouring pixels, picked per frame by renderFractal
+enum precisionTier {
+      floatTier,
+      doubleTier,
+      doubleDoubleTier,
+      perturbationTier
+};
+
+const char* tierNames[] = { "float", "double", "double-double", "perturbation" };
+
+// What the fractal's primary reference orbit was computed for, bits being 0 until there is one. (jr, ji) is
+// the constant of a Julia set's orbit.
+struct referenceKey {
+      BigFloat x, y;
+      int bits = 0;
+      int imax = 0;
+      bool compressed = false;
+      orbitFormula formula = mandelbrotOrbit;
+      bool julia = false;
+      BigFloat jr, ji;
+};
+
+// Everything but imax that decides a frame's escape times, to tell whether a fractal's iteration buffer still
+// shows its view
+struct frameKey {
+      BigFloat x, y, jr, ji;
+      floatExp magnification;
+      int size = 0;
+      int type = -1, escapen = -1;
+      precisionTier tier = precisionTier::floatTier;
+      renderSettings settings;
+};
+
+bool sameFrame(const frameKey& a, const frameKey& b) {
+      return a.x == b.x && a.y == b.y && a.jr == b.jr && a.ji == b.ji
+            && a.magnification.m == b.magnification.m && a.magnification.e == b.magnification.e
+            && a.size == b.size && a.type == b.type && a.escapen == b.escapen && a.tier == b.tier
+            && a.settings.method == b.settings.method && a.settings.rebase == b.settings.rebase
+            && a.settings.certify == b.settings.certify && a.settings.render == b.settings.render;
+}
+
 struct fractal {
       sf::Sprite frame;
       sf::Texture texture;
 
       int size;
 
-      long double x = 0.0l;
-      long double y = 0.0l;
+      BigFloat x = 0.0;
+      BigFloat y = 0.0;
 
-      long double zr = 0.0l;
-      long double zi = 0.0l;
+      BigFloat zr = 0.0;
+      BigFloat zi = 0.0;
 
-      float magnification = 1.0f;
+      floatExp magnification = 1.0;
       int imax = 100;
       float bounds = 2.0f;
+      precisionTier tier = precisionTier::doubleTier;
+
+      referenceOrbit orbit;
+      referenceKey orbitKey;
+      seriesApproximation series;
+      blaTable bla;
+
+      // deep zoom counters for the last frame
+      std::atomic<int> references{0};
+      std::atomic<long long> rebases{0};
+
+      // pixels filled from a certified tile in the last frame
+      std::atomic<long long> certified{0};
+
+      // pixels actually iterated in the last subdivided or traced frame
+      std::atomic<long long> iterated{0};
+
+      // Escape times of the view in computed, each iterated up to computedImax. Frames whose pixels all went
+      // through computeSpans in float or double also keep the z each pixel stopped at, and computeSpans
+      // resumes those still bounded at resumeFrom instead of starting over.
+      std::vector<float> iters;
+      std::vector<double> stopr, stopi;
+      frameKey computed;
+      int computedImax = 0;
+      int resumeFrom = 0;
+
+      // RGBA words of the last colouring, and the palette of colormap paletteMap it used
+      std::vector<uint32_t> pixels;
+      std::vector<uint32_t> palette;
+      int paletteMap = -1;
 
       fractal(int x): size(x) {
             texture.create(size, size);
@@ -44,21 +157,25 @@ float d(float min, float max, float z) {
 	return z*(max-min) + min;
 }
 
-long double frameToComplexCoord(int x0, fractal& fract, long double origin) {
-      return ( (long double)x0/fract.size * fract.bounds*2 - fract.bounds ) / fract.magnification + origin;
+// distance of a pixel row or column from the frame's centre
+floatExp frameToComplexOffset(int x0, fractal& fract) {
+      return ( (double)x0/fract.size * fract.bounds*2 - fract.bounds ) / fract.magnification;
 }
 
-sf::Vector2<long double> screenToComplexCoords(sf::Vector2<int> mousePos, fractal& fract) {
+BigFloat frameToComplexCoord(int x0, fractal& fract, const BigFloat& origin) {
+      return origin + BigFloat(frameToComplexOffset(x0, fract), origin.precision());
+}
+
+sf::Vector2<BigFloat> screenToComplexCoords(sf::Vector2<int> mousePos, fractal& fract) {
       sf::Rect<int> bounds(fract.frame.getGlobalBounds());
-      return sf::Vector2<long double>(
+      return sf::Vector2<BigFloat>(
             frameToComplexCoord(mousePos.x - bounds.left, fract, fract.x),
             frameToComplexCoord(mousePos.y - bounds.top, fract, fract.y)
       );      
 }
 
-const int mapN = 2;
-sf::Color (*colormaps[mapN])(float i, int imax) = {
-      [](float i, int imax) -> sf::Color {
+struct blueColormap {
+      static inline sf::Color map(float i, int imax) {
             float x = i / imax;
             x = x > 1 ? 1 : x;
             int c = x*255;
@@ -73,8 +190,11 @@ sf::Color (*colormaps[mapN])(float i, int imax) = {
                   float n = norm(0, 0.2, x);
                   return sf::Color(d(0, 51, 1-n), d(0, 51, n), c*3 +51);
             }
-      },
-      [](float i, int imax) -> sf::Color {
+      }
+};
+
+struct greenColormap {
+      static inline sf::Color map(float i, int imax) {
             float x = i/imax;
             int c = x*255;
 
@@ -85,104 +205,972 @@ sf::Color (*colormaps[mapN])(float i, int imax) = {
             } else {
                   return sf::Color(0, c*2, 0);
             }
-      },
+      }
 };
 
-const long double euler = 2.71828182845904523536028l;
-const int escapeN = 3;
-float (*escapeTests[escapeN])(const long double cr, const long double ci, int imax, long double zr, long double zi) = {
-      [](const long double cr, const long double ci, int imax, long double zr = 0.0l, long double zi = 0.0l) -> float { // standard mandelbrot set
-            register int i = 0;
-
-            register long double zr2 = zr*zr,
-                        zi2 = zi*zi;
-
-            while (zr2 + zi2 <= 4.0l and i < imax) {
-                  zi = 2*zr*zi + ci;
-                  zr = zr2 - zi2 + cr;
-                  zr2 = zr*zr;
-                  zi2 = zi*zi;
-                  i++;
-            }     
-
-            return i;
-      },
-      [](const long double cr, const long double ci, int imax, long double zr = 0.0l, long double zi = 0.0l) -> float { // the burning ship
-            int i = 0;
-
-            long double zr2 = zr*zr,
-                        zi2 = zi*zi;
-
-            while (zr2 + zi2 < 4.0l and i < imax) {
-                  zi = abs(zr*zi*2) + ci;
-                  zr = zr2 - zi2 + cr;
-                  zr2 = zr*zr;
-                  zi2 = zi*zi;
-                  i++;
-            }     
-
-            return i;       
-      },
-      [](const long double cr, const long double ci, int imax, long double zr = 0.0l, long double zi = 0.0l) -> float { // 
-            Complex c(cr, ci);
-            Complex z(zr, zi);
-            Complex one(1, 0);
-            Complex tmp;
-            int i = 0;
-
-            while (z.modulusSqrd() < 4.0l and i < imax) {
-                  tmp = z + c;
-                  z = one/(tmp*tmp*tmp);
-                  i++;
-            }     
-
-            return i;       
-      },
-};
+typedef typeList<blueColormap, greenColormap> colormaps;
+const int mapN = colormaps::N;
+
+const int escapeN = formulas::N;
 
 bool isMouseInFrame(sf::Vector2<int> mousePos, sf::Sprite& frame) {
       sf::Rect<int> bounds(frame.getGlobalBounds());
       return bounds.contains(mousePos);
 }
 
-void render(fractal* fract, fractalType fract_type, sf::Image* image, int startRows, int endRows, int mapn, int escapen) {  
+// The colormap at paletteSize + 1 evenly spaced points from no iterations to imax, as RGBA words in the
+// texture's byte order. Colormaps only look at i/imax, so one palette serves every imax.
+template <typename Colormap>
+std::vector<uint32_t> makePalette() {
+      std::vector<uint32_t> palette(paletteSize + 1);
+      for (int i = 0; i <= paletteSize; i++) {
+            sf::Color color = Colormap::map(i, paletteSize);
+            sf::Uint8 rgba[4] = { color.r, color.g, color.b, color.a };
+            std::memcpy(&palette[i], rgba, 4);
+      }
+      return palette;
+}
+
+// distance between neighbouring pixels in the complex plane
+floatExp pixelSpacing(fractal& fract) {
+      return fract.bounds*2 / fract.magnification / fract.size;
+}
+
+// whether a mantissa of the given bits still tells neighbouring pixels apart, with a few to spare
+bool resolves(fractal& fract, int bits) {
+      double extent = std::max(std::fabs(double(fract.x)), std::fabs(double(fract.y))) + double(fract.bounds / fract.magnification);
+      return pixelSpacing(fract) > extent * std::ldexp(1.0, 5 - bits);
+}
+
+// whether offsets from the centre are still normal doubles, past that the delta kernels take floatExp
+bool deltasFitDouble(fractal& fract) {
+      return pixelSpacing(fract).e > -960;
+}
+
+// bits needed to tell neighbouring pixels apart anywhere in the frame, with some to spare for the orbit
+int precisionFor(fractal& fract) {
+      double extent = std::max(std::fabs(double(fract.x)), std::fabs(double(fract.y))) + double(fract.bounds / fract.magnification);
+      return std::ceil(std::log2(extent) - pixelSpacing(fract).log2()) + 32;
+}
+
+// Coordinates only ever gain precision, so zooming back in after zooming out lands where it started
+void fitPrecision(fractal& fract) {
+      int bits = std::max(precisionFor(fract), fract.x.precision());
+      fract.x.setPrecision(bits);
+      fract.y.setPrecision(bits);
+      fract.zr.setPrecision(bits);
+      fract.zi.setPrecision(bits);
+}
+
+const int ddBits = 106;
+
+// Precision the frame's reference orbits are computed in
+int referenceBits(fractal& fract) {
+      return precisionFor(fract) <= ddBits ? ddBits : fract.x.precision();
+}
+
+// Reference orbit at the frame's centre plus (dr, di), in double-double while that still resolves the frame.
+// Julia orbits start there with the fractal's constant (zr, zi) as c. parallel lets a deep orbit use helper
+// threads, for references computed while the render threads are idle.
+void computeReferenceAt(fractal& fract, referenceOrbit& orbit, floatExp dr, floatExp di, orbitFormula formula, bool julia, bool parallel) {
+      bool compress = fract.imax >= compressedOrbitIterations;
+
+      if (referenceBits(fract) == ddBits) {
+            dd pr = dd(fract.x) + double(dr), pi = dd(fract.y) + double(di);
+            if (julia) computeJuliaReference(orbit, pr, pi, dd(fract.zr), dd(fract.zi), fract.imax, compress, formula);
+            else computeReference(orbit, pr, pi, fract.imax, compress, formula);
+      } else {
+            BigFloat pr = fract.x + BigFloat(dr, fract.x.precision()), pi = fract.y + BigFloat(di, fract.y.precision());
+            if (julia) computeJuliaReference(orbit, pr, pi, fract.zr, fract.zi, fract.imax, compress, formula, parallel);
+            else computeReference(orbit, pr, pi, fract.imax, compress, formula, parallel);
+      }
+}
+
+// The orbit at the frame's centre, kept from the last frame while the centre stays put and it was computed
+// in at least the precision this one needs. A larger imax extends it in place, at its own precision.
+// Counts a reference only when it computes or extends one.
+void updateReference(fractal& fract, orbitFormula formula, bool julia) {
+      referenceKey& key = fract.orbitKey;
+      bool compress = fract.imax >= compressedOrbitIterations;
+      bool sameJulia = !julia || (key.jr == fract.zr && key.ji == fract.zi);
+
+      if (key.bits >= referenceBits(fract) && key.compressed == compress && key.formula == formula && key.julia == julia && sameJulia &&
+            key.x == fract.x && key.y == fract.y) {
+            if (fract.imax > key.imax) {
+                  const BigFloat& cr = julia ? fract.zr : fract.x;
+                  const BigFloat& ci = julia ? fract.zi : fract.y;
+                  if (key.bits == ddBits) {
+                        extendReference(fract.orbit, dd(cr), dd(ci), fract.imax);
+                  } else {
+                        extendReference(fract.orbit, cr, ci, fract.imax, true);
+                  }
+                  key.imax = fract.imax;
+                  fract.references++;
+            }
+            return;
+      }
+
+      computeReferenceAt(fract, fract.orbit, 0.0, 0.0, formula, julia, true);
+      fract.references++;
+      key = referenceKey{ fract.x, fract.y, referenceBits(fract), fract.imax, compress, formula, julia, fract.zr, fract.zi };
+}
+
+// Series and BLA table for a reference serving pixels up to radius from it. Neither is fitted past double
+// range, where the deltas start from iteration 0, or to the burning ship, whose fold is not analytic.
+// Julia sets get no BLA table, its steps are fitted to the mandelbrot set's dc term. Compressed orbits get a
+// coarse one whichever deep zoom method is picked, their pixels can't be iterated a vector at a time anyway.
+void fitApproximations(fractal& fract, const referenceOrbit& orbit, floatExp radius, seriesApproximation& series, blaTable& bla) {
+      bla = blaTable();
+      if (!deltasFitDouble(fract) || orbit.formula != mandelbrotOrbit) {
+            series = noSeries(orbit.julia);
+            return;
+      }
+
+      series = approximateSeries(orbit, double(radius), fract.imax);
+      bool bilinear = settings.method == deepZoomMethod::bilinear || orbit.compressed;
+      if (bilinear && !orbit.julia) buildBLA(bla, orbit, double(radius));
+}
+
+// The render threads, started on first use and woken for each job rather than started for it
+class workerPool {
+      public:
+            workerPool(int _threads): threads(_threads) {
+                  for (int k = 1; k < threads; k++) helpers.emplace_back(&workerPool::help, this, k);
+            }
+
+            ~workerPool() {
+                  {
+                        std::lock_guard<std::mutex> guard(lock);
+                        stopping = true;
+                        generation++;
+                  }
+                  wake.notify_all();
+                  for (std::thread& helper : helpers) helper.join();
+            }
+
+            // job(k) for every k < threads, the calling thread taking k = 0, returning once all are done. A
+            // job that runs the pool again, from whichever thread, has it done serially on that thread.
+            void run(const std::function<void(int)>& job) {
+                  if (inJob) {
+                        for (int k = 0; k < threads; k++) job(k);
+                        return;
+                  }
+
+                  std::unique_lock<std::mutex> turn(running);
+                  {
+                        std::lock_guard<std::mutex> guard(lock);
+                        current = &job;
+                        pending = threads - 1;
+                        generation++;
+                  }
+                  wake.notify_all();
+
+                  inJob = true;
+                  job(0);
+                  inJob = false;
+
+                  std::unique_lock<std::mutex> guard(lock);
+                  done.wait(guard, [&] { return pending == 0; });
+            }
+
+      private:
+            int threads;
+            std::vector<std::thread> helpers;
+            std::mutex running, lock;
+            std::condition_variable wake, done;
+            const std::function<void(int)>* current = NULL;
+            long long generation = 0;
+            int pending = 0;
+            bool stopping = false;
+
+            static thread_local bool inJob;
+
+            void help(int k) {
+                  long long seen = 0;
+                  inJob = true;
+
+                  while (true) {
+                        const std::function<void(int)>* job;
+                        {
+                              std::unique_lock<std::mutex> guard(lock);
+                              wake.wait(guard, [&] { return generation != seen; });
+                              if (stopping) return;
+                              seen = generation;
+                              job = current;
+                        }
+
+                        (*job)(k);
+
+                        std::lock_guard<std::mutex> guard(lock);
+                        if (--pending == 0) done.notify_one();
+                  }
+            }
+};
+
+thread_local bool workerPool::inJob = false;
+
+workerPool& renderThreads() {
+      static workerPool pool(THREAD_COUNT);
+      return pool;
+}
+
+// Runs work(startRows, endRows) over the frame's rows split across the render threads
+template <typename F>
+void forEachRowBlock(int rows, F work) {
+      int rowsPerThread = rows/THREAD_COUNT;
+
+      renderThreads().run([&](int i) {
+            int targetRows = i == THREAD_COUNT-1 ? rows : (i+1)*rowsPerThread;
+            work(i*rowsPerThread, targetRows);
+      });
+}
+
+// Iteration counts of rows [startRows, endRows) with pixel coordinates rounded to T. When the fractal keeps
+// stopping points they are written to stopr and stopi, and with a nonzero resumeFrom only the pixels that
+// reached it are iterated further, from those points.
+template <typename T>
+void computeSpans(fractal* fract, spanKernel<T> span, float* iters, int startRows, int endRows) {
+      int size = fract -> size, from = fract -> resumeFrom;
+      bool keep = !fract -> stopr.empty();
+      std::vector<T> px(size), py(size), x(size), zr(size), zi(size);
+      std::vector<int> columns(size);
+      std::vector<float> out(size);
+
+      for (int screenX = 0; screenX < size; screenX++) {
+            px[screenX] = T(frameToComplexCoord(screenX, *fract, fract -> x));
+      }
+
+      for (int screenY = startRows; screenY < endRows; screenY++) {
+            float* row = iters + size*screenY;
+            std::fill(py.begin(), py.end(), T(frameToComplexCoord(screenY, *fract, fract -> y)));
+
+            if (!keep) {
+                  span(px.data(), py.data(), T(fract -> zr), T(fract -> zi), 0, fract -> imax, row, NULL, NULL, size);
+                  continue;
+            }
+
+            double* sr = fract -> stopr.data() + size*screenY;
+            double* si = fract -> stopi.data() + size*screenY;
+            int n = 0;
+            for (int screenX = 0; screenX < size; screenX++) {
+                  if (from > 0 && row[screenX] != from) continue;
+                  columns[n] = screenX;
+                  x[n] = px[screenX];
+                  zr[n] = T(sr[screenX]);
+                  zi[n] = T(si[screenX]);
+                  n++;
+            }
+
+            span(x.data(), py.data(), T(fract -> zr), T(fract -> zi), from, fract -> imax, out.data(), zr.data(), zi.data(), n);
+            for (int k = 0; k < n; k++) {
+                  row[columns[k]] = out[k];
+                  sr[columns[k]] = double(zr[k]);
+                  si[columns[k]] = double(zi[k]);
+            }
+      }
+}
+
+// Rows [startRows, endRows) in tiles, each filled at once when certifyTile proves its escape time and split in
+// four otherwise, down to tiles of minTile pixels. Their pixels are gathered into one span call at the end so
+// the kernel's lanes stay full.
+template <typename T>
+void computeTiles(fractal* fract, spanKernel<T> span, bool julia, bool ship, float* iters, int startRows, int endRows) {
+      const int tileSize = 32, minTile = 4;
+      struct tileRect { int x, y, w, h; };
+
+      int size = fract -> size;
+      std::vector<T> px(size), py(size);
+      std::vector<double> cx(size), cy(size);
+      double jr = double(fract -> zr), ji = double(fract -> zi);
+
+      for (int screenX = 0; screenX < size; screenX++) {
+            BigFloat x = frameToComplexCoord(screenX, *fract, fract -> x);
+            px[screenX] = T(x);
+            cx[screenX] = double(x);
+      }
+
+      for (int screenY = startRows; screenY < endRows; screenY++) {
+            BigFloat y = frameToComplexCoord(screenY, *fract, fract -> y);
+            py[screenY] = T(y);
+            cy[screenY] = double(y);
+      }
+
+      std::vector<T> ux, uy;
+      std::vector<int> uncertain;
+
+      std::vector<tileRect> pending;
+      for (int y = startRows; y < endRows; y += tileSize) {
+            for (int x = 0; x < size; x += tileSize) {
+                  pending.push_back(tileRect{ x, y, std::min(tileSize, size - x), std::min(tileSize, endRows - y) });
+            }
+      }
+
+      while (!pending.empty()) {
+            tileRect t = pending.back();
+            pending.pop_back();
+
+            // the ball around the tile's pixels also covers rounding them to double
+            double x0 = cx[t.x], x1 = cx[t.x + t.w - 1], y0 = cy[t.y], y1 = cy[t.y + t.h - 1];
+            double mr = (x0 + x1) / 2, mi = (y0 + y1) / 2;
+            double radius = std::hypot(x1 - x0, y1 - y0) / 2 + ballRounding * (std::fabs(mr) + std::fabs(mi));
+
+            int escape = julia ? certifyTile(orbitBall{ mr, mi, radius }, ship, jr, ji, 0, fract -> imax)
+                               : certifyTile(orbitBall{ 0, 0, 0 }, ship, mr, mi, radius, fract -> imax);
+
+            if (escape >= 0) {
+                  for (int y = t.y; y < t.y + t.h; y++) {
+                        std::fill(iters + size*y + t.x, iters + size*y + t.x + t.w, escape);
+                  }
+                  fract -> certified += t.w * t.h;
+            } else if (t.w <= minTile && t.h <= minTile) {
+                  for (int y = t.y; y < t.y + t.h; y++) {
+                        for (int x = t.x; x < t.x + t.w; x++) {
+                              ux.push_back(px[x]);
+                              uy.push_back(py[y]);
+                              uncertain.push_back(size*y + x);
+                        }
+                  }
+            } else {
+                  int w = t.w > minTile ? t.w / 2 : t.w, h = t.h > minTile ? t.h / 2 : t.h;
+                  pending.push_back(tileRect{ t.x, t.y, w, h });
+                  if (w < t.w) pending.push_back(tileRect{ t.x + w, t.y, t.w - w, h });
+                  if (h < t.h) pending.push_back(tileRect{ t.x, t.y + h, w, t.h - h });
+                  if (w < t.w && h < t.h) pending.push_back(tileRect{ t.x + w, t.y + h, t.w - w, t.h - h });
+            }
+      }
+
+      std::vector<float> out(uncertain.size());
+      span(ux.data(), uy.data(), T(fract -> zr), T(fract -> zi), 0, fract -> imax, out.data(), NULL, NULL, out.size());
+      for (size_t k = 0; k < uncertain.size(); k++) {
+            iters[uncertain[k]] = out[k];
+      }
+}
+
+perturbKernel deepZoomKernel(const referenceOrbit& orbit) {
+      bool bilinear = settings.method == deepZoomMethod::bilinear && orbit.formula == mandelbrotOrbit && !orbit.julia;
+      return bilinear ? kernels().bla[orbit.julia][orbit.formula] : kernels().perturb[orbit.julia][orbit.formula];
+}
+
+// Rows of deltas D, double or floatExp, from the frame's reference, returning the kernel's rebase count
+template <typename D, typename Kernel>
+long long perturbRows(fractal* fract, const perturbationFrame& frame, Kernel kernel, float* iters, int startRows, int endRows) {
+      int size = fract -> size;
+      std::vector<D> dcr(size), dci(size);
+      long long rebases = 0;
+
+      for (int screenX = 0; screenX < size; screenX++) {
+            dcr[screenX] = D(frameToComplexOffset(screenX, *fract));
+      }
+
       for (int screenY = startRows; screenY < endRows; screenY++) {
-            long double pi = frameToComplexCoord(screenY, *fract, fract -> y);
+            std::fill(dci.begin(), dci.end(), D(frameToComplexOffset(screenY, *fract)));
+            rebases += kernel(frame, dcr.data(), dci.data(), fract -> imax, iters + size*screenY, size);
+      }
+
+      return rebases;
+}
+
+// Rows as deltas from fract -> orbit, which is centred on (x, y)
+void computePerturbed(fractal* fract, float* iters, int startRows, int endRows) {
+      perturbationFrame frame = frameOf(fract -> orbit, fract -> series, fract -> bla, settings.rebase);
+
+      if (deltasFitDouble(*fract)) {
+            fract -> rebases += perturbRows<double>(fract, frame, deepZoomKernel(fract -> orbit), iters, startRows, endRows);
+      } else {
+            fract -> rebases += perturbRows<floatExp>(fract, frame, kernels().perturbExp[fract -> orbit.julia][fract -> orbit.formula], iters, startRows, endRows);
+      }
+}
+
+// Connected regions of glitched pixels, largest first
+std::vector<std::vector<int>> findGlitches(const float* iters, int size) {
+      std::vector<std::vector<int>> groups;
+      std::vector<bool> seen(size*size, false);
 
-            for (int screenX = 0; screenX < fract -> size; screenX++) {
-                  long double pr = frameToComplexCoord(screenX, *fract, fract -> x);
+      for (int start = 0; start < size*size; start++) {
+            if (seen[start] || iters[start] != glitchedPixel) continue;
 
-                  float i = fract_type == fractalType::mandelbrot ?
-                        escapeTests[escapen](pr, pi, fract -> imax, 0.0l, 0.0l) :
-                        escapeTests[escapen](fract -> zr, fract -> zi, fract -> imax, pr, pi);
+            std::vector<int> group(1, start);
+            seen[start] = true;
 
-                  image -> setPixel(screenX, screenY, colormaps[mapn](i, fract -> imax));
+            for (size_t k = 0; k < group.size(); k++) {
+                  int x = group[k] % size, y = group[k] / size;
+                  int neighbours[4][2] = { {x-1, y}, {x+1, y}, {x, y-1}, {x, y+1} };
+
+                  for (auto& n : neighbours) {
+                        if (n[0] < 0 || n[1] < 0 || n[0] >= size || n[1] >= size) continue;
+                        int j = n[1]*size + n[0];
+                        if (seen[j] || iters[j] != glitchedPixel) continue;
+                        seen[j] = true;
+                        group.push_back(j);
+                  }
             }
+
+            groups.push_back(group);
       }
+
+      std::sort(groups.begin(), groups.end(), [](const std::vector<int>& a, const std::vector<int>& b) {
+            return a.size() > b.size();
+      });
+      return groups;
 }
 
+// Re-renders one glitched region against its own reference orbit, taken at the pixel nearest its centroid
+void fixGlitchGroup(fractal* fract, const std::vector<int>* group, float* iters) {
+      int size = fract -> size;
+      int n = group -> size();
+
+      double cx = 0, cy = 0;
+      for (int j : *group) {
+            cx += j % size;
+            cy += j / size;
+      }
+      cx /= n;
+      cy /= n;
+
+      int ref = (*group)[0];
+      for (int j : *group) {
+            if (std::hypot(j % size - cx, j / size - cy) < std::hypot(ref % size - cx, ref / size - cy)) ref = j;
+      }
+
+      floatExp refr = frameToComplexOffset(ref % size, *fract), refi = frameToComplexOffset(ref / size, *fract);
+      std::vector<floatExp> dcr(n), dci(n);
+      std::vector<float> out(n);
+      floatExp radius = 0.0;
+
+      for (int k = 0; k < n; k++) {
+            dcr[k] = frameToComplexOffset((*group)[k] % size, *fract) - refr;
+            dci[k] = frameToComplexOffset((*group)[k] / size, *fract) - refi;
+            radius = std::max(radius, hypot(dcr[k], dci[k]));
+      }
+
+      referenceOrbit orbit;
+      seriesApproximation series;
+      blaTable bla;
+      computeReferenceAt(*fract, orbit, refr, refi, fract -> orbit.formula, fract -> orbit.julia, false);
+      fitApproximations(*fract, orbit, radius, series, bla);
+      perturbationFrame frame = frameOf(orbit, series, bla, settings.rebase);
+
+      fract -> references++;
+      if (deltasFitDouble(*fract)) {
+            std::vector<double> dr(dcr.begin(), dcr.end()), di(dci.begin(), dci.end());
+            fract -> rebases += deepZoomKernel(orbit)(frame, dr.data(), di.data(), fract -> imax, out.data(), n);
+      } else {
+            fract -> rebases += kernels().perturbExp[orbit.julia][orbit.formula](frame, dcr.data(), dci.data(), fract -> imax, out.data(), n);
+      }
+
+      for (int k = 0; k < n; k++) {
+            iters[(*group)[k]] = out[k];
+      }
+}
+
+// Keeps adding secondary references, one per glitched region and up to one region per render thread at a time,
+// until no pixel is glitched. Whatever is left after the last round is drawn as unescaped.
+void fixGlitches(fractal& fract, float* iters) {
+      const int maxRounds = 32;
+
+      for (int round = 0; round < maxRounds; round++) {
+            std::vector<std::vector<int>> groups = findGlitches(iters, fract.size);
+            if (groups.empty()) return;
+
+            int n = std::min<int>(groups.size(), THREAD_COUNT);
+            std::vector<std::thread> threads;
+            for (int g = 0; g < n; g++) {
+                  threads.emplace_back(fixGlitchGroup, &fract, &groups[g], iters);
+            }
+            for (std::thread& thread : threads) {
+                  thread.join();
+            }
+      }
+
+      std::replace(iters, iters + fract.size*fract.size, glitchedPixel, (float)fract.imax);
+}
+
+// Centres the view on the nucleus of the atom domain (cr, ci) lies in, zoomed to show its whole minibrot with
+// enough iterations for the pixels around it to escape. Only for the mandelbrot formula, the others aren't analytic.
+void jumpToNucleus(fractal& fract, BigFloat cr, BigFloat ci) {
+      int period = atomPeriod(cr, ci, fract.imax);
+      floatExp size;
+      if (period == 0 || !locateNucleus(cr, ci, period, size)) {
+            std::cout << "No nucleus found under the cursor\n";
+            return;
+      }
+
+      fract.x = cr;
+      fract.y = ci;
+      fract.magnification = floatExp(1.0) / size;
+      fract.imax = std::max(fract.imax, 16*period);
+      std::cout << "Nucleus of period " << period << ", size 2^" << std::round(size.log2()) << "\n";
+}
+
+// Floats, then doubles; past double precision the mandelbrot and burning ship formulas are perturbed from
+// a reference orbit and everything else falls back to double-double
+precisionTier selectTier(fractal& fract, int escapen) {
+      // Rounding errors build up over an orbit like a random walk, about sqrt(imax) ulps, so of a float's 24
+      // bits half of log2(imax) go to them and another 4 are kept spare. floatAgrees checks the result.
+      int floatBits = 20 - std::ceil(std::log2(std::max(fract.imax, 1)) / 2);
+      if (resolves(fract, floatBits)) return precisionTier::floatTier;
+      if (resolves(fract, 53)) return precisionTier::doubleTier;
+      if (escapen < orbitFormulaN) return precisionTier::perturbationTier;
+      return precisionTier::doubleDoubleTier;
+}
+
+// Share of sampled pixels floats may get wrong before a frame goes to doubles instead
+const double floatMismatch = 0.01;
+
+// Whether float escape times agree with double ones on a grid of every sampleStep'th pixel each way. How far
+// a float orbit strays depends on the formula and the view as much as on the pixel spacing, Julia sets being
+// the most sensitive, so selectTier's float frames are checked this way before being drawn.
+bool floatAgrees(fractal& fract, fractalType type, int escapen) {
+      const int sampleStep = 8;
+      bool julia = type == fractalType::julia;
+      spanKernel<float> floatSpan = kernels().floatSpans[julia][escapen];
+      spanKernel<double> doubleSpan = kernels().spans[julia][escapen];
+      int n = (fract.size + sampleStep - 1) / sampleStep, imax = fract.imax;
+      std::vector<double> px(n);
+      std::vector<float> fx(n);
+      std::atomic<int> mismatches{0};
+
+      for (int k = 0; k < n; k++) {
+            px[k] = double(frameToComplexCoord(k*sampleStep, fract, fract.x));
+            fx[k] = float(px[k]);
+      }
+
+      forEachRowBlock(n, [&](int startRows, int endRows) {
+            std::vector<double> py(n);
+            std::vector<float> fy(n), fout(n), dout(n);
+            auto shown = [imax](float i) { return i == interiorPixel ? imax : i; };
+
+            for (int row = startRows; row < endRows; row++) {
+                  std::fill(py.begin(), py.end(), double(frameToComplexCoord(row*sampleStep, fract, fract.y)));
+                  std::fill(fy.begin(), fy.end(), float(py[0]));
+                  floatSpan(fx.data(), fy.data(), float(fract.zr), float(fract.zi), 0, imax, fout.data(), NULL, NULL, n);
+                  doubleSpan(px.data(), py.data(), double(fract.zr), double(fract.zi), 0, imax, dout.data(), NULL, NULL, n);
+                  for (int k = 0; k < n; k++) {
+                        if (shown(fout[k]) != shown(dout[k])) mismatches++;
+                  }
+            }
+      });
+
+      return mismatches <= floatMismatch * n*n;
+}
+
+// Specialized on the fractal type and formula, in the frame's precision tier. Certified tiles need the centre
+// of the ball to hold the tile's coordinates, so they stop at the double tier.
+template <fractalType type, int escapen>
+void computeRows(fractal* fract, float* iters, int startRows, int endRows) {
+      const bool julia = type == fractalType::julia;
+      const bool certified = settings.certify && escapen < orbitFormulaN;
+
+      switch (fract -> tier) {
+            case precisionTier::floatTier:
+                  if (certified) computeTiles<float>(fract, kernels().floatSpans[julia][escapen], julia, escapen == burningShipOrbit, iters, startRows, endRows);
+                  else computeSpans<float>(fract, kernels().floatSpans[julia][escapen], iters, startRows, endRows);
+                  break;
+            case precisionTier::doubleTier:
+                  if (certified) computeTiles<double>(fract, kernels().spans[julia][escapen], julia, escapen == burningShipOrbit, iters, startRows, endRows);
+                  else computeSpans<double>(fract, kernels().spans[julia][escapen], iters, startRows, endRows);
+                  break;
+            case precisionTier::doubleDoubleTier:
+                  computeSpans<dd>(fract, kernels().ddSpans[julia][escapen], iters, startRows, endRows);
+                  break;
+            case precisionTier::perturbationTier:
+                  computePerturbed(fract, iters, startRows, endRows);
+                  break;
+      }
+}
+
+// Escape times of any pixels, given as indices y*size + x, in the frame's precision tier
+typedef std::function<void(const int* pixels, int n, float* out)> pixelComputer;
+
+template <typename T>
+pixelComputer spanPixels(fractal* fract, spanKernel<T> span) {
+      int size = fract -> size, imax = fract -> imax;
+      std::vector<T> px(size), py(size);
+      T jr = T(fract -> zr), ji = T(fract -> zi);
+
+      for (int k = 0; k < size; k++) {
+            px[k] = T(frameToComplexCoord(k, *fract, fract -> x));
+            py[k] = T(frameToComplexCoord(k, *fract, fract -> y));
+      }
+
+      return [=](const int* pixels, int n, float* out) {
+            std::vector<T> x(n), y(n);
+            for (int k = 0; k < n; k++) {
+                  x[k] = px[pixels[k] % size];
+                  y[k] = py[pixels[k] / size];
+            }
+            span(x.data(), y.data(), jr, ji, 0, imax, out, NULL, NULL, n);
+      };
+}
+
+template <typename D, typename Kernel>
+pixelComputer perturbedPixels(fractal* fract, Kernel kernel) {
+      int size = fract -> size, imax = fract -> imax;
+      perturbationFrame frame = frameOf(fract -> orbit, fract -> series, fract -> bla, settings.rebase);
+      std::vector<D> offsets(size);
+
+      for (int k = 0; k < size; k++) {
+            offsets[k] = D(frameToComplexOffset(k, *fract));
+      }
+
+      return [=](const int* pixels, int n, float* out) {
+            std::vector<D> dcr(n), dci(n);
+            for (int k = 0; k < n; k++) {
+                  dcr[k] = offsets[pixels[k] % size];
+                  dci[k] = offsets[pixels[k] / size];
+            }
+            fract -> rebases += kernel(frame, dcr.data(), dci.data(), imax, out, n);
+      };
+}
+
+template <fractalType type, int escapen>
+pixelComputer tierPixels(fractal* fract) {
+      const bool julia = type == fractalType::julia;
+
+      switch (fract -> tier) {
+            case precisionTier::floatTier:
+                  return spanPixels<float>(fract, kernels().floatSpans[julia][escapen]);
+            case precisionTier::doubleTier:
+                  return spanPixels<double>(fract, kernels().spans[julia][escapen]);
+            case precisionTier::doubleDoubleTier:
+                  return spanPixels<dd>(fract, kernels().ddSpans[julia][escapen]);
+            case precisionTier::perturbationTier:
+                  if (deltasFitDouble(*fract)) return perturbedPixels<double>(fract, deepZoomKernel(fract -> orbit));
+                  return perturbedPixels<floatExp>(fract, kernels().perturbExp[fract -> orbit.julia][fract -> orbit.formula]);
+      }
+
+      return pixelComputer();
+}
+
+// Escape times of the given pixels into iters, counted in fract.iterated
+void iteratePixels(fractal& fract, float* iters, const pixelComputer& compute, const std::vector<int>& pixels) {
+      std::vector<float> out(pixels.size());
+      compute(pixels.data(), pixels.size(), out.data());
+      for (size_t k = 0; k < pixels.size(); k++) iters[pixels[k]] = out[k];
+      fract.iterated += pixels.size();
+}
+
+// Mariani-Silver: a rectangle whose border has a single escape time is filled with it, others are cut in four
+// along a row and a column through the middle, computing only those, down to rectangles of minSide that are
+// computed whole. The frame starts as a grid of maxSide cells, so no fill is larger than that, whose lines the
+// render threads compute together before the cells are shared out to them from one stack. Exact as long as nothing inside a uniform border differs
+// from it, which holds for the mandelbrot set's interior and for most escape bands.
+void subdivideFrame(fractal& fract, float* iters, const pixelComputer& compute) {
+      const int minSide = 8, maxSide = 64;
+      struct rect { int x0, y0, x1, y1; }; // inclusive, the border already computed
+
+      int size = fract.size;
+      auto computeAll = [&](std::vector<int>& pixels) {
+            iteratePixels(fract, iters, compute, pixels);
+            pixels.clear();
+      };
+
+      std::vector<int> lines;
+      for (int k = 0; k < size; k += maxSide) lines.push_back(k);
+      if (lines.back() != size - 1) lines.push_back(size - 1);
+
+      std::vector<int> grid;
+      std::vector<bool> onGrid(size, false);
+      for (int k : lines) onGrid[k] = true;
+      for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                  if (onGrid[x] || onGrid[y]) grid.push_back(size*y + x);
+            }
+      }
+
+      // the grid lines first, in chunks the render threads take in turn
+      const int gridChunk = 1024;
+      std::atomic<int> nextChunk{0};
+      forEachRowBlock(THREAD_COUNT, [&](int, int) {
+            std::vector<int> pixels;
+            for (int start = nextChunk.fetch_add(gridChunk); start < (int)grid.size(); start = nextChunk.fetch_add(gridChunk)) {
+                  pixels.assign(grid.begin() + start, grid.begin() + std::min<int>(start + gridChunk, grid.size()));
+                  computeAll(pixels);
+            }
+      });
+
+      std::vector<rect> pending;
+      for (size_t j = 1; j < lines.size(); j++) {
+            for (size_t i = 1; i < lines.size(); i++) pending.push_back(rect{ lines[i-1], lines[j-1], lines[i], lines[j] });
+      }
+      std::mutex lock;
+      std::condition_variable changed;
+      int busy = 0;
+
+      // one worker per render thread
+      forEachRowBlock(THREAD_COUNT, [&](int, int) {
+            std::vector<int> pixels;
+
+            while (true) {
+                  rect r;
+                  {
+                        std::unique_lock<std::mutex> guard(lock);
+                        changed.wait(guard, [&] { return !pending.empty() || busy == 0; });
+                        if (pending.empty()) return;
+                        r = pending.back();
+                        pending.pop_back();
+                        busy++;
+                  }
+
+                  float v = iters[size*r.y0 + r.x0];
+                  bool uniform = true;
+                  for (int x = r.x0; x <= r.x1 && uniform; x++) uniform = iters[size*r.y0 + x] == v && iters[size*r.y1 + x] == v;
+                  for (int y = r.y0; y <= r.y1 && uniform; y++) uniform = iters[size*y + r.x0] == v && iters[size*y + r.x1] == v;
+
+                  std::vector<rect> children;
+                  if (uniform) {
+                        for (int y = r.y0 + 1; y < r.y1; y++) std::fill(iters + size*y + r.x0 + 1, iters + size*y + r.x1, v);
+                  } else if (r.x1 - r.x0 <= minSide || r.y1 - r.y0 <= minSide) {
+                        for (int y = r.y0 + 1; y < r.y1; y++) {
+                              for (int x = r.x0 + 1; x < r.x1; x++) pixels.push_back(size*y + x);
+                        }
+                        computeAll(pixels);
+                  } else {
+                        int mx = (r.x0 + r.x1) / 2, my = (r.y0 + r.y1) / 2;
+                        for (int x = r.x0 + 1; x < r.x1; x++) pixels.push_back(size*my + x);
+                        for (int y = r.y0 + 1; y < r.y1; y++) if (y != my) pixels.push_back(size*y + mx);
+                        computeAll(pixels);
+                        children = { { r.x0, r.y0, mx, my }, { mx, r.y0, r.x1, my }, { r.x0, my, mx, r.y1 }, { mx, my, r.x1, r.y1 } };
+                  }
+
+                  std::lock_guard<std::mutex> guard(lock);
+                  pending.insert(pending.end(), children.begin(), children.end());
+                  busy--;
+                  changed.notify_all();
+            }
+      });
+}
+
+// Boundary tracing: each tile of tileSide computes its edge, then keeps computing the unknown neighbours of every
+// pixel that differs from one of its own 8 neighbours, a wave at a time, so only the contours between escape
+// times get iterated. Whatever is left is enclosed by pixels of one value and filled from the left. Tiles go
+// to the render threads one at a time.
+void traceFrame(fractal& fract, float* iters, const pixelComputer& compute) {
+      const int tileSide = 64;
+      enum pixelState : char { unknown, queued, known };
+
+      int size = fract.size, tilesAcross = (size + tileSide - 1) / tileSide;
+      std::vector<char> state(size*size, unknown);
+      std::atomic<int> nextTile{0};
+
+      // one worker per render thread
+      forEachRowBlock(THREAD_COUNT, [&](int, int) {
+            std::vector<int> wave, next;
+
+            for (int tile = nextTile++; tile < tilesAcross*tilesAcross; tile = nextTile++) {
+                  int x0 = tile % tilesAcross * tileSide, y0 = tile / tilesAcross * tileSide;
+                  int x1 = std::min(x0 + tileSide, size) - 1, y1 = std::min(y0 + tileSide, size) - 1;
+
+                  auto enqueue = [&](int x, int y) {
+                        int p = size*y + x;
+                        if (x < x0 || x > x1 || y < y0 || y > y1 || state[p] != unknown) return;
+                        state[p] = queued;
+                        next.push_back(p);
+                  };
+                  auto enqueueAround = [&](int p) {
+                        for (int dy = -1; dy <= 1; dy++) {
+                              for (int dx = -1; dx <= 1; dx++) enqueue(p % size + dx, p / size + dy);
+                        }
+                  };
+
+                  for (int x = x0; x <= x1; x++) {
+                        enqueue(x, y0);
+                        enqueue(x, y1);
+                  }
+                  for (int y = y0; y <= y1; y++) {
+                        enqueue(x0, y);
+                        enqueue(x1, y);
+                  }
+
+                  while (!next.empty()) {
+                        wave.swap(next);
+                        next.clear();
+                        iteratePixels(fract, iters, compute, wave);
+                        for (int p : wave) state[p] = known;
+
+                        for (int p : wave) {
+                              int x = p % size, y = p / size;
+                              bool contour = false;
+                              for (int dy = -1; dy <= 1; dy++) {
+                                    for (int dx = -1; dx <= 1; dx++) {
+                                          if (x + dx < x0 || x + dx > x1 || y + dy < y0 || y + dy > y1) continue;
+                                          int q = p + size*dy + dx;
+                                          if (state[q] != known || iters[q] == iters[p]) continue;
+                                          contour = true;
+                                          enqueueAround(q);
+                                    }
+                              }
+                              if (contour) enqueueAround(p);
+                        }
+                  }
+
+                  for (int y = y0 + 1; y < y1; y++) {
+                        for (int x = x0 + 1; x < x1; x++) {
+                              if (state[size*y + x] == unknown) iters[size*y + x] = iters[size*y + x - 1];
+                        }
+                  }
+            }
+      });
+}
+
+typedef void (*rowComputer)(fractal* fract, float* iters, int startRows, int endRows);
+typedef pixelComputer (*pixelComputerMaker)(fractal* fract);
+typedef std::vector<uint32_t> (*paletteMaker)();
+
+// one entry per fractal type and formula, indexed by type*escapeN + escapen
+template <int... K>
+constexpr std::array<rowComputer, sizeof...(K)> makeComputers(std::integer_sequence<int, K...>) {
+      return {{ computeRows<fractalType(K / escapeN), K % escapeN>... }};
+}
+
+template <int... K>
+constexpr std::array<pixelComputerMaker, sizeof...(K)> makePixelComputers(std::integer_sequence<int, K...>) {
+      return {{ tierPixels<fractalType(K / escapeN), K % escapeN>... }};
+}
+
+template <int... K>
+constexpr std::array<paletteMaker, sizeof...(K)> makePalettes(std::integer_sequence<int, K...>) {
+      return {{ makePalette<typename typeAt<K, colormaps>::type>... }};
+}
+
+const std::array<rowComputer, 2*escapeN> computers = makeComputers(std::make_integer_sequence<int, 2*escapeN>());
+const std::array<pixelComputerMaker, 2*escapeN> pixelComputers = makePixelComputers(std::make_integer_sequence<int, 2*escapeN>());
+const std::array<paletteMaker, mapN> palettes = makePalettes(std::make_integer_sequence<int, mapN>());
+
+// Every pixel of a new view, in the tier's kernels or by the render method's pixel order
+void computeFrame(fractal& fract, fractalType type, int escapen) {
+      float* iters = fract.iters.data();
+      int pixelCount = fract.size*fract.size;
+      bool keep = (fract.tier == precisionTier::floatTier || fract.tier == precisionTier::doubleTier)
+            && settings.render == renderMethod::everyPixel && !settings.certify;
+
+      fract.resumeFrom = 0;
+      fract.stopr.assign(keep ? pixelCount : 0, 0.0);
+      fract.stopi.assign(keep ? pixelCount : 0, 0.0);
+
+      if (settings.render != renderMethod::everyPixel) {
+            pixelComputer computePixels = pixelComputers[type*escapeN + escapen](&fract);
+            if (settings.render == renderMethod::subdivision) subdivideFrame(fract, iters, computePixels);
+            else traceFrame(fract, iters, computePixels);
+            std::cout << "Iterated " << fract.iterated << " of " << pixelCount << " pixels ("
+                  << std::round(100.0 * fract.iterated / pixelCount) << "%)\n";
+      } else {
+            rowComputer compute = computers[type*escapeN + escapen];
+            forEachRowBlock(fract.size, [&](int startRows, int endRows) {
+                  compute(&fract, iters, startRows, endRows);
+            });
+      }
+}
+
+// Carries the pixels still bounded at computedImax on to imax, leaving the rest of the frame as it is. They
+// continue from where they stopped when the frame kept their z and start over otherwise.
+void resumeFrame(fractal& fract, fractalType type, int escapen) {
+      float* iters = fract.iters.data();
+      int pixelCount = fract.size*fract.size;
+      std::vector<int> bounded;
+
+      for (int p = 0; p < pixelCount; p++) {
+            if (iters[p] == fract.computedImax) bounded.push_back(p);
+      }
+      std::cout << "Resumed " << bounded.size() << " of " << pixelCount << " pixels\n";
+
+      if (!fract.stopr.empty()) {
+            rowComputer compute = computers[type*escapeN + escapen];
+            fract.resumeFrom = fract.computedImax;
+            forEachRowBlock(fract.size, [&](int startRows, int endRows) {
+                  compute(&fract, iters, startRows, endRows);
+            });
+            fract.resumeFrom = 0;
+            return;
+      }
+
+      pixelComputer computePixels = pixelComputers[type*escapeN + escapen](&fract);
+      forEachRowBlock(bounded.size(), [&](int start, int end) {
+            iteratePixels(fract, iters, computePixels, std::vector<int>(bounded.begin() + start, bounded.begin() + end));
+      });
+}
+
+// Frames smaller than this are coloured on the calling thread, waking the render threads costing more
+const int parallelColorPixels = 1 << 18;
+
+// Colouring stage: fract.iters through the colormap's palette into the texture, iterating nothing. The
+// palette is only rebuilt when the colormap changed.
+void colorFractal(fractal& fract, int mapn) {
+      int size = fract.size;
+      if (fract.computedImax == 0 || (int)fract.iters.size() != size*size) return; // nothing computed at this size
+
+      if (mapn != fract.paletteMap) {
+            fract.palette = palettes[mapn]();
+            fract.paletteMap = mapn;
+      }
+
+      fract.pixels.resize(size*size);
+      colorKernel color = kernels().color;
+      if (size*size < parallelColorPixels) {
+            color(fract.iters.data(), fract.palette.data(), fract.imax, fract.pixels.data(), size*size);
+      } else {
+            forEachRowBlock(size, [&](int startRows, int endRows) {
+                  color(fract.iters.data() + size*startRows, fract.palette.data(), fract.imax, fract.pixels.data() + size*startRows, size*(endRows - startRows));
+            });
+      }
+
+      fract.texture.update((const sf::Uint8*)fract.pixels.data());
+}
+
+// Compute stage, then colouring. Escape times go to fract.iters and are kept, so a frame whose view hasn't
+// changed only iterates when imax went up, and then only the pixels that hadn't escaped. Lowering imax just
+// clamps them as they are coloured.
 void renderFractal(fractal& fract, fractalType type, int mapn, int escapen) {
-      sf::Image image;
-	image.create(fract.size, fract.size, sf::Color(0, 0, 0));
+      precisionTier tier = selectTier(fract, escapen);
+      bool perturbed = tier == precisionTier::perturbationTier;
+
+      fitPrecision(fract);
+
+      // keyed on the tier selectTier picked, whether or not floats passed their check
+      frameKey view = { fract.x, fract.y, fract.zr, fract.zi, fract.magnification, fract.size, type, escapen, tier, settings };
+      bool same = fract.computedImax > 0 && sameFrame(view, fract.computed);
+      bool iterate = !same || fract.imax > fract.computedImax;
+      fract.iters.resize(fract.size*fract.size);
+
+      if (!iterate) tier = fract.tier;
+      else if (tier == precisionTier::floatTier && !floatAgrees(fract, type, escapen)) tier = precisionTier::doubleTier;
+      if (tier != fract.tier) same = false; // a resumed float frame that failed its check starts over in doubles
+
+      if (tier != fract.tier) {
+            std::cout << (type == fractalType::julia ? "Julia" : "Mandelbrot") << " precision: " << tierNames[tier];
+            if (tier == precisionTier::doubleDoubleTier && !resolves(fract, 106)) std::cout << ", too shallow for this zoom";
+            std::cout << "\n";
+      }
+      fract.tier = tier;
 
-      std::thread threads[THREAD_COUNT] = {};
-	int rowsPerThread = fract.size/THREAD_COUNT;
+      if (iterate) {
+            if (perturbed) {
+                  fract.references = 0;
+                  fract.rebases = 0;
+                  floatExp radius = std::sqrt(2.0) * fract.bounds / fract.magnification;
+                  updateReference(fract, orbitFormula(escapen), type == fractalType::julia);
+                  fitApproximations(fract, fract.orbit, radius, fract.series, fract.bla);
+            }
 
-	for (int i = 0; i < THREAD_COUNT; i++) {
-		int targetRows = (i+1)*rowsPerThread;
+            fract.certified = 0;
+            fract.iterated = 0;
+            if (same) resumeFrame(fract, type, escapen);
+            else computeFrame(fract, type, escapen);
 
-		if (i == THREAD_COUNT-1) {
-			targetRows = fract.size;
-		}
+            if (settings.certify && fract.certified > 0) {
+                  std::cout << "Certified: " << fract.certified << " of " << fract.size*fract.size << " pixels\n";
+            }
 
-		threads[i] = std::thread(render, &fract, type, &image, i*rowsPerThread, targetRows, mapn, escapen);
-	}
+            if (perturbed) {
+                  fixGlitches(fract, fract.iters.data());
+                  std::cout << "Deep zoom: " << fract.references << " references, " << fract.rebases << " rebases\n";
+            }
 
-	for (int i = 0; i < THREAD_COUNT; i++) {
-		threads[i].join();
-	}
+            fract.computed = view;
+            fract.computedImax = fract.imax;
+      }
 
-      fract.texture.loadFromImage(image);
+      colorFractal(fract, mapn);
 }
 
 void resizeFractal(fractal& fract, int newsize) {
@@ -193,6 +1181,7 @@ void resizeFractal(fractal& fract, int newsize) {
 
 int main() {
       std::cout << "RUNNING\n";
+      std::cout << "Kernels: " << kernels().name << "\n";
 
       int width = 1000;
       int height = 500;
@@ -228,12 +1217,13 @@ int main() {
       while (window.isOpen()) {
             bool draw_all = false;
             bool draw = false;
+            bool recolor = false;
             // bsool inFocus = window.hasFocus();
             sf::Event event;
             mouseScreenPos0 = mouseScreenPos;
             mouseScreenPos = sf::Mouse::getPosition(window);
             
-            sf::Vector2<long double> mousePlanePos = screenToComplexCoords(mouseScreenPos, activefractal? *activefractal : mandelbrot);
+            sf::Vector2<BigFloat> mousePlanePos = screenToComplexCoords(mouseScreenPos, activefractal? *activefractal : mandelbrot);
 
             if (paused == false) {
                   julia.zr = mousePlanePos.x;
@@ -291,11 +1281,11 @@ int main() {
                                           break;
                                     case Keyboard::Key::C:
                                           colormap = (colormap+1)%mapN;
-                                          draw_all = true;
+                                          recolor = true;
                                           break;
                                     case Keyboard::Key::R:
-                                          activefractal -> x = 0.0l;
-                                          activefractal -> y = 0.0l;
+                                          activefractal -> x = 0.0;
+                                          activefractal -> y = 0.0;
                                           activefractal -> magnification = 1.0f;
                                           activefractal -> imax = 100;
                                           draw = true;
@@ -310,6 +1300,31 @@ int main() {
                                                 activefractal -> imax /= 1.1;
                                           draw = true;
                                           break;
+                                    case Keyboard::Key::B:
+                                          settings.method = settings.method == deepZoomMethod::bilinear ? deepZoomMethod::perturbation : deepZoomMethod::bilinear;
+                                          std::cout << "Deep zoom: " << (settings.method == deepZoomMethod::bilinear ? "bilinear approximation" : "perturbation") << "\n";
+                                          draw_all = true;
+                                          break;
+                                    case Keyboard::Key::G:
+                                          settings.rebase = !settings.rebase;
+                                          std::cout << "Rebasing: " << (settings.rebase ? "on" : "off") << "\n";
+                                          draw_all = true;
+                                          break;
+                                    case Keyboard::Key::I:
+                                          settings.certify = !settings.certify;
+                                          std::cout << "Certified tiles: " << (settings.certify ? "on" : "off") << "\n";
+                                          draw_all = true;
+                                          break;
+                                    case Keyboard::Key::M:
+                                          settings.render = renderMethod((settings.render + 1) % renderMethodN);
+                                          std::cout << "Render: " << renderMethodNames[settings.render] << "\n";
+                                          draw_all = true;
+                                          break;
+                                    case Keyboard::Key::N:
+                                          if (activefractal != &mandelbrot || escapetest != mandelbrotOrbit) break;
+                                          jumpToNucleus(mandelbrot, mousePlanePos.x, mousePlanePos.y);
+                                          draw = true;
+                                          break;
                                     case Keyboard::Key::V: 
                                           escapetest = (escapetest+1)%escapeN;
                                           draw_all = true;
@@ -320,6 +1335,12 @@ int main() {
                   }
             }
 
+            // a new colormap only reruns the colouring stage
+            if (recolor == true) {
+                  colorFractal(mandelbrot, colormap);
+                  colorFractal(julia, colormap);
+            }
+
             if (draw_all == true || (draw == true and activefractal == &mandelbrot)) 
                   renderFractal(mandelbrot, fractalType::mandelbrot, colormap, escapetest);
             if (draw_all == true || (draw == true and activefractal == &julia) || (mouseScreenPos != mouseScreenPos0 and paused == false))
@@ -0,0 +1,160 @@
+#include <OrbitStore.hpp>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+      #include <windows.h>
+#else
+      #include <fcntl.h>
+      #include <sys/mman.h>
+      #include <unistd.h>
+#endif
+
+// Mapped files grow by doubling from this many waypoints
+static const size_t FIRST_MAPPING = 1 << 16;
+
+// The temporary file behind a spilled store, deleted as soon as it is closed
+struct spillFile {
+#ifdef _WIN32
+      HANDLE handle;
+      HANDLE mapping;
+#else
+      int fd;
+#endif
+};
+
+static spillFile* openSpillFile(const char* dir) {
+      spillFile* f = new spillFile;
+#ifdef _WIN32
+      char path[MAX_PATH];
+      if (GetTempFileNameA(dir, "orb", 0, path) == 0) {
+            delete f;
+            return NULL;
+      }
+      f -> handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+      f -> mapping = NULL;
+      if (f -> handle == INVALID_HANDLE_VALUE) {
+            delete f;
+            return NULL;
+      }
+#else
+      std::string path = std::string(dir) + "/mandelbrot-orbit-XXXXXX";
+      f -> fd = mkstemp(&path[0]);
+      if (f -> fd < 0) {
+            delete f;
+            return NULL;
+      }
+      unlink(path.c_str());
+#endif
+      return f;
+}
+
+static void closeSpillFile(spillFile* f) {
+#ifdef _WIN32
+      CloseHandle(f -> handle);
+#else
+      close(f -> fd);
+#endif
+      delete f;
+}
+
+waypointStore::waypointStore(): mapped(NULL), count(0), capacity(0), file(NULL) {}
+
+waypointStore::~waypointStore() {
+      unmap();
+      if (file != NULL) closeSpillFile((spillFile*)file);
+}
+
+void waypointStore::unmap() {
+      if (mapped == NULL) return;
+#ifdef _WIN32
+      spillFile* f = (spillFile*)file;
+      UnmapViewOfFile(mapped);
+      CloseHandle(f -> mapping);
+      f -> mapping = NULL;
+#else
+      munmap(mapped, capacity * sizeof(orbitWaypoint));
+#endif
+      mapped = NULL;
+}
+
+// Remaps the file at a larger size, keeping what was written so far
+bool waypointStore::map(size_t newCapacity) {
+      spillFile* f = (spillFile*)file;
+      size_t bytes = newCapacity * sizeof(orbitWaypoint);
+      unmap();
+
+#ifdef _WIN32
+      f -> mapping = CreateFileMappingA(f -> handle, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)bytes >> 32), (DWORD)bytes, NULL);
+      if (f -> mapping == NULL) return false;
+      mapped = (orbitWaypoint*)MapViewOfFile(f -> mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+#else
+      if (ftruncate(f -> fd, bytes) != 0) return false;
+      void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, f -> fd, 0);
+      mapped = p == MAP_FAILED ? NULL : (orbitWaypoint*)p;
+#endif
+
+      if (mapped == NULL) return false;
+      capacity = newCapacity;
+      return true;
+}
+
+void waypointStore::clear() {
+      unmap();
+      if (file != NULL) closeSpillFile((spillFile*)file);
+      file = NULL;
+      memory.clear();
+      count = 0;
+      capacity = 0;
+}
+
+// Opens the spill file if the environment asks for one, on a store's first waypoint so orbits that are
+// never compressed don't touch the disk
+void waypointStore::spill() {
+      const char* dir = std::getenv("MANDELBROT_ORBIT_SPILL");
+      if (dir == NULL) return;
+
+      file = openSpillFile(dir);
+      if (file == NULL || !map(FIRST_MAPPING)) {
+            std::cout << "Could not spill the reference orbit to " << dir << ", keeping it in memory\n";
+            if (file != NULL) closeSpillFile((spillFile*)file);
+            file = NULL;
+      }
+}
+
+void waypointStore::push(const orbitWaypoint& w) {
+      if (count == 0 && file == NULL) spill();
+
+      if (file == NULL) {
+            memory.push_back(w);
+            count++;
+            return;
+      }
+
+      if (count == capacity && !map(2*capacity)) {
+            // out of disk, carry on in memory with what was mapped so far
+            std::cout << "Reference orbit spill file full, moving it to memory\n";
+            std::vector<orbitWaypoint> copy(count);
+            map(capacity);
+            if (mapped != NULL) std::memcpy(copy.data(), mapped, count * sizeof(orbitWaypoint));
+            unmap();
+            closeSpillFile((spillFile*)file);
+            file = NULL;
+            memory.swap(copy);
+            memory.push_back(w);
+            count++;
+            return;
+      }
+
+      mapped[count++] = w;
+}
+
+void regenerateStep(double& zr, double& zi, double cr, double ci, bool ship) {
+      double t = zr*zr - zi*zi + cr;
+      zi = ship ? std::fabs(2*zr*zi) + ci : 2*zr*zi + ci;
+      zr = t;
+}
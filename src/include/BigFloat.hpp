@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <DoubleDouble.hpp>
+#include <FloatExp.hpp>
+
+// Binary floating point with a runtime number of 64 bit limbs, for coordinates and reference orbits past
+// double-double. The value is (-1)^neg * 0.m * 2^exp with the mantissa m normalized so its top bit is set.
+// Results take the larger precision of their operands and are truncated to it.
+class BigFloat {
+	public:
+		static const int LIMB_BITS = 64;
+		static const int MIN_BITS = 128;
+
+		BigFloat();
+
+		BigFloat(double x);
+
+		BigFloat(const dd& x);
+
+		// x rounded to at least the given number of bits
+		BigFloat(double x, int bits);
+
+		BigFloat(const floatExp& x, int bits);
+
+		int precision() const {
+			return LIMB_BITS * limbs.size();
+		}
+
+		// Extends the mantissa with zeros or truncates it, to whole limbs
+		void setPrecision(int bits);
+
+		bool isZero() const {
+			return limbs.back() == 0;
+		}
+
+		explicit operator float() const {
+			return double(*this);
+		}
+
+		explicit operator double() const;
+
+		explicit operator dd() const;
+
+		// keeps the exponent of values past double range
+		explicit operator floatExp() const;
+
+		friend BigFloat operator - (const BigFloat& a);
+
+		friend BigFloat operator + (const BigFloat& a, const BigFloat& b);
+		friend BigFloat operator - (const BigFloat& a, const BigFloat& b);
+		friend BigFloat operator * (const BigFloat& a, const BigFloat& b);
+
+		friend BigFloat operator + (const BigFloat& a, double b) { return a + BigFloat(b, a.precision()); }
+		friend BigFloat operator - (const BigFloat& a, double b) { return a - BigFloat(b, a.precision()); }
+		friend BigFloat operator * (const BigFloat& a, double b);
+		friend BigFloat operator * (double a, const BigFloat& b) { return b * a; }
+
+		// -1, 0 or 1 as a is less than, equal to or greater than b
+		friend int compare(const BigFloat& a, const BigFloat& b);
+
+		friend bool operator < (const BigFloat& a, const BigFloat& b) { return compare(a, b) < 0; }
+		friend bool operator > (const BigFloat& a, const BigFloat& b) { return compare(a, b) > 0; }
+		friend bool operator <= (const BigFloat& a, const BigFloat& b) { return compare(a, b) <= 0; }
+		friend bool operator >= (const BigFloat& a, const BigFloat& b) { return compare(a, b) >= 0; }
+		friend bool operator == (const BigFloat& a, const BigFloat& b) { return compare(a, b) == 0; }
+
+		friend bool operator < (const BigFloat& a, double b) { return compare(a, BigFloat(b)) < 0; }
+		friend bool operator > (const BigFloat& a, double b) { return compare(a, BigFloat(b)) > 0; }
+
+		// In place forms for hot loops, r may alias either operand. Reusing r avoids reallocating its limbs.
+		static void add(BigFloat& r, const BigFloat& a, const BigFloat& b);
+		static void sub(BigFloat& r, const BigFloat& a, const BigFloat& b);
+		static void mul(BigFloat& r, const BigFloat& a, const BigFloat& b);
+
+		// a^2, computing each cross product once
+		static void sqr(BigFloat& r, const BigFloat& a);
+
+		static void abs(BigFloat& r, const BigFloat& a) {
+			if (&r != &a) r = a;
+			r.neg = false;
+		}
+
+		// multiplies by 2^k exactly
+		void scale(int64_t k) {
+			if (!isZero()) exp += k;
+		}
+
+	private:
+		std::vector<uint64_t> limbs; // least significant first
+		int64_t exp;
+		bool neg;
+
+		static void addSigned(BigFloat& r, const BigFloat& a, const BigFloat& b, bool negateB);
+		static void normalize(BigFloat& r, const uint64_t* m, int n, int64_t exp, bool neg, int limbCount);
+};
+
+inline BigFloat sqr(const BigFloat& a) {
+	BigFloat r;
+	BigFloat::sqr(r, a);
+	return r;
+}
+
+inline BigFloat abs(const BigFloat& a) {
+	BigFloat r;
+	BigFloat::abs(r, a);
+	return r;
+}
+
+// Threads squaring several numbers at once, for loops like the reference orbit's that need a few independent
+// squares per step. Helpers spin between steps, so a team should only live as long as its loop.
+class squaringTeam {
+	public:
+		// The calling thread plus threads - 1 helpers, no more than the machine has cores
+		squaringTeam(int threads);
+
+		~squaringTeam();
+
+		squaringTeam(const squaringTeam&) = delete;
+		squaringTeam& operator = (const squaringTeam&) = delete;
+
+		// r[k] = a[k]^2 for k < n, shared round robin between the threads. r[k] may alias a[k].
+		void sqr(BigFloat* const r[], const BigFloat* const a[], int n);
+
+	private:
+		int threads;
+		std::vector<std::thread> helpers;
+		BigFloat* const* results;
+		const BigFloat* const* operands;
+		int count;
+		std::atomic<int> generation, pending;
+		std::atomic<bool> stopping;
+
+		void run(int thread);
+		void help(int thread);
+};
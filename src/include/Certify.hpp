@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cmath>
+
+// Escape times proven for a whole tile at once. Every orbit starting in the tile is enclosed in a ball, a
+// centre and radius in doubles with the radius grown by each step's rounding error, iterated with the formula.
+// Only the mandelbrot and burning ship formulas are handled, the ship's fold moves no point further from the
+// centre than it was.
+
+// Rounding error of one step, relative to the magnitudes that went into it
+const double ballRounding = 0x1p-50;
+
+// Interior tests per checkpoint before waiting for the next one
+const int ballAttempts = 8;
+
+struct orbitBall {
+	double zr, zi, r;
+
+	double centreModulus() const {
+		return std::sqrt(zr*zr + zi*zi);
+	}
+
+	// whether every point is still bounded, or has escaped
+	bool bounded() const {
+		return (centreModulus() + r) * (1 + ballRounding) < 2;
+	}
+
+	bool escaped() const {
+		return (centreModulus() - r) * (1 - ballRounding) > 2;
+	}
+
+	double distance(const orbitBall& b) const {
+		return std::sqrt((zr - b.zr)*(zr - b.zr) + (zi - b.zi)*(zi - b.zi));
+	}
+
+	bool inside(const orbitBall& b) const {
+		return (distance(b) + r) * (1 + ballRounding) <= b.r;
+	}
+
+	// z^2 + c for every z in the ball and c within cradius of (cr, ci)
+	void step(bool ship, double cr, double ci, double cradius) {
+		double mod = centreModulus();
+		double error = ballRounding * (zr*zr + zi*zi + std::fabs(cr) + std::fabs(ci));
+		double t = zr*zr - zi*zi + cr;
+		zi = ship ? std::fabs(2*zr*zi) + ci : 2*zr*zi + ci;
+		zr = t;
+		r = (2*mod*r + r*r + cradius + error) * (1 + ballRounding);
+	}
+};
+
+// Whether the ball maps into itself within period steps, all bounded on the way. The orbit of every point
+// in it then stays in those balls forever, so none of them escape.
+inline bool ballContracts(orbitBall b, int period, bool ship, double cr, double ci, double cradius) {
+	orbitBall start = b;
+
+	for (int n = 0; n < period; n++) {
+		if (!b.bounded()) return false;
+		b.step(ship, cr, ci, cradius);
+	}
+
+	return b.inside(start);
+}
+
+// Escape time shared by every orbit starting in ball z with a constant within cradius of (cr, ci), imax when
+// none of them escape, or -1 when it can't be proven. For the mandelbrot set z starts as the point 0, for a
+// Julia set c is a single point. Interior tiles are found Brent style: the ball is saved at powers of two and
+// when the centre comes back into the saved ball, the saved one inflated is tested with ballContracts.
+inline int certifyTile(orbitBall z, bool ship, double cr, double ci, double cradius, int imax) {
+	orbitBall saved = z;
+	int savedAt = 0, attempts = 0;
+
+	for (int n = 0; n < imax; n++) {
+		if (z.escaped()) return n;
+		if (!z.bounded()) return -1;
+
+		if (n > savedAt && attempts < ballAttempts && z.distance(saved) < saved.r) {
+			attempts++;
+			orbitBall inflated = { saved.zr, saved.zi, 2*saved.r + z.distance(saved) };
+			if (ballContracts(inflated, n - savedAt, ship, cr, ci, cradius)) return imax;
+		}
+
+		if (n == 2*savedAt + 1) {
+			saved = z;
+			savedAt = n;
+			attempts = 0;
+		}
+
+		z.step(ship, cr, ci, cradius);
+	}
+
+	return imax;
+}
@@ -1,42 +1,46 @@
+#pragma once
+
+#include <Simd.hpp>
 #include <cmath>
 
+// Kernel code only, so in the instruction set's namespace like the kernels that use it
+namespace KERNEL_ISA {
+
+template <typename T>
 class Complex {
 	public:
-		long double R, I;
+		T R, I;
 
-		Complex() {
-			R = 0.0l, I = 0.0l;
-		}
+		constexpr Complex(): R(), I() {}
 
-		Complex(long double _r, long double _i) {
-			R = _r, I = _i;
-		}
+		constexpr Complex(T _r, T _i): R(_r), I(_i) {}
 
-		long double modulus() {
-			return sqrtl(R*R + I*I);
+		T modulus() const {
+			using std::sqrt;
+			return sqrt(R*R + I*I);
 		}
 
-		long double modulusSqrd() {
+		constexpr T modulusSqrd() const {
 			return R*R + I*I;
 		}
 
-		Complex operator + (Complex w) {
+		constexpr Complex operator + (const Complex& w) const {
 			return Complex(R + w.R, I + w.I);
 		}
 
-		Complex operator - (Complex w) {
+		constexpr Complex operator - (const Complex& w) const {
 			return Complex(R - w.R, I - w.I);
 		}
 
-		Complex operator * (Complex w) {
+		constexpr Complex operator * (const Complex& w) const {
 			return Complex(
 				R * w.R - I * w.I,
 				R * w.I + I * w.R
 			);
 		}
 
-		Complex operator / (Complex w) {
-			long double divInv = 1.0l / (w.R * w.R + w.I * w.I);
+		constexpr Complex operator / (const Complex& w) const {
+			T divInv = 1 / w.modulusSqrd();
 
 			return Complex(
 				(R * w.R + I * w.I) * divInv,
@@ -44,17 +48,50 @@ class Complex {
 			);
 		}
 
-		Complex operator ^ (Complex w) {
-			if (R == 0.0l && I == 0.0l) {
-				return Complex(0, 0);
+		// 1/z, cheaper than Complex(1, 0)/z
+		constexpr Complex reciprocal() const {
+			T divInv = 1 / modulusSqrd();
+			return Complex(R * divInv, -I * divInv);
+		}
+
+		// integer powers by repeated squaring
+		constexpr Complex operator ^ (int n) const {
+			if (n < 0) {
+				return (*this ^ -n).reciprocal();
+			}
+
+			Complex base = *this, result(T() + 1, T());
+			bool first = true;
+
+			for (; n > 0; n >>= 1) {
+				if (n & 1) {
+					result = first ? base : result * base;
+					first = false;
+				}
+				if (n > 1) base = base * base;
+			}
+
+			return result;
+		}
+
+		Complex operator ^ (const Complex& w) const {
+			if (w.I == 0 && w.R >= -64 && w.R <= 64 && w.R == (int)w.R) {
+				return *this ^ (int)w.R;
+			}
+			if (R == 0 && I == 0) {
+				return Complex();
 			}
-			Complex exponent = w * Complex( logl(modulus()), atan2l(I, R) );
-			long double ex = expl(exponent.R);
-			long double im = exponent.I;
+			using std::log; using std::atan2; using std::exp; using std::cos; using std::sin;
+
+			Complex exponent = w * Complex( log(modulus()), atan2(I, R) );
+			T ex = exp(exponent.R);
+			T im = exponent.I;
 
 			return Complex(
-				ex * cosl(im),
-				ex * sinl(im)
+				ex * cos(im),
+				ex * sin(im)
 			);
 		}
-};
\ No newline at end of file
+};
+
+}
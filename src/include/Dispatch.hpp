@@ -0,0 +1,47 @@
+#pragma once
+
+#include <DoubleDouble.hpp>
+#include <FloatExp.hpp>
+#include <Perturbation.hpp>
+#include <cstdint>
+
+const int formulaN = 3;
+
+// Escape times of n pixels, interiorPixel for those known never to escape, optionally resuming from and
+// keeping the z they stopped at, see Kernels.hpp
+template <typename T>
+using spanKernel = void (*)(const T* px, const T* py, T jr, T ji, int from, int imax, float* out, T* zr, T* zi, int n);
+
+// Written by the span kernels in place of imax for pixels inside the set's cardioid or bulb, or whose orbit
+// was caught repeating, and drawn as imax
+const float interiorPixel = -2.0f;
+
+// Deltas dc from a frame's reference orbit, returning how many rebases happened, see PerturbationKernels.hpp
+typedef long long (*perturbKernel)(const perturbationFrame& frame, const double* dcr, const double* dci, int imax, float* out, int n);
+
+// The same for deltas below double range
+typedef long long (*perturbExpKernel)(const perturbationFrame& frame, const floatExp* dcr, const floatExp* dci, int imax, float* out, int n);
+
+// Colours in a palette past its first, whatever imax is
+const int paletteSize = 4096;
+
+// RGBA words of n escape times from a palette of paletteSize + 1 colours, see Kernels.hpp
+typedef void (*colorKernel)(const float* iters, const uint32_t* palette, int imax, uint32_t* out, int n);
+
+// One instruction set's build of every kernel, indexed by [julia][formula], the perturbation kernels' formula
+// being the orbit's
+struct kernelTable {
+	const char* name;
+	spanKernel<float> floatSpans[2][formulaN];
+	spanKernel<double> spans[2][formulaN];
+	spanKernel<dd> ddSpans[2][formulaN];
+	perturbKernel perturb[2][orbitFormulaN];
+	perturbKernel bla[2][orbitFormulaN];
+	perturbExpKernel perturbExp[2][orbitFormulaN];
+	colorKernel color;
+};
+
+extern const kernelTable scalarKernels, sse2Kernels, avx2Kernels, avx512Kernels;
+
+// Widest table the cpu supports, or the one named by the MANDELBROT_ISA environment variable
+const kernelTable& kernels();
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+
+// Error-free transforms: each returns the rounded result and stores the exact rounding error in err.
+// T is double, or a vector of doubles to carry one number per lane. These and the operations below are static
+// so that each kernel translation unit, built for its own instruction set, keeps its own copy instead of the
+// linker picking one for all of them.
+
+template <typename T>
+static inline T twoSum(T a, T b, T& err) {
+	T s = a + b;
+	T bb = s - a;
+	err = (a - (s - bb)) + (b - bb);
+	return s;
+}
+
+// requires |a| >= |b|
+template <typename T>
+static inline T quickTwoSum(T a, T b, T& err) {
+	T s = a + b;
+	err = b - (s - a);
+	return s;
+}
+
+template <typename T>
+static inline T twoProd(T a, T b, T& err) {
+	T p = a * b;
+#ifdef __FMA__
+	if constexpr (std::is_same<T, double>::value) {
+		err = __builtin_fma(a, b, -p);
+	} else {
+		for (unsigned k = 0; k < sizeof(T)/sizeof(double); k++) err[k] = __builtin_fma(a[k], b[k], -p[k]);
+	}
+#else
+	// Dekker's split, only exact when a*b - p is not contracted, which needs FMA hardware anyway
+	const double split = 134217729.0; // 2^27 + 1
+	T ta = split * a, tb = split * b;
+	T ah = ta - (ta - a), bh = tb - (tb - b);
+	T al = a - ah, bl = b - bh;
+	err = ((ah*bh - p) + ah*bl + al*bh) + al*bl;
+#endif
+	return p;
+}
+
+// Unevaluated sum hi + lo of two doubles, about 106 bits of mantissa
+template <typename T>
+struct DoubleDouble {
+	T hi, lo;
+
+	constexpr DoubleDouble(): hi(), lo() {}
+
+	constexpr DoubleDouble(T _hi, T _lo): hi(_hi), lo(_lo) {}
+
+	DoubleDouble(double x): hi(T() + x), lo() {}
+
+	DoubleDouble(long double x): hi((double)x), lo((double)(x - (double)x)) {}
+
+	explicit operator long double() const {
+		return (long double)hi + lo;
+	}
+
+	explicit operator double() const {
+		return hi + lo;
+	}
+};
+
+template <typename T>
+static inline DoubleDouble<T> operator - (const DoubleDouble<T>& a) {
+	return DoubleDouble<T>(-a.hi, -a.lo);
+}
+
+template <typename T>
+static inline DoubleDouble<T> operator + (const DoubleDouble<T>& a, const DoubleDouble<T>& b) {
+	T e, f;
+	T s = twoSum(a.hi, b.hi, e);
+	T t = twoSum(a.lo, b.lo, f);
+	e += t;
+	s = quickTwoSum(s, e, e);
+	e += f;
+	s = quickTwoSum(s, e, e);
+	return DoubleDouble<T>(s, e);
+}
+
+template <typename T>
+static inline DoubleDouble<T> operator + (const DoubleDouble<T>& a, double b) {
+	T e;
+	T s = twoSum(a.hi, T() + b, e);
+	e += a.lo;
+	s = quickTwoSum(s, e, e);
+	return DoubleDouble<T>(s, e);
+}
+
+template <typename T>
+static inline DoubleDouble<T> operator - (const DoubleDouble<T>& a, const DoubleDouble<T>& b) {
+	return a + -b;
+}
+
+template <typename T>
+static inline DoubleDouble<T> operator * (const DoubleDouble<T>& a, const DoubleDouble<T>& b) {
+	T e;
+	T p = twoProd(a.hi, b.hi, e);
+	e += a.hi*b.lo + a.lo*b.hi;
+	p = quickTwoSum(p, e, e);
+	return DoubleDouble<T>(p, e);
+}
+
+template <typename T>
+static inline DoubleDouble<T> operator * (const DoubleDouble<T>& a, double b) {
+	T e;
+	T p = twoProd(a.hi, T() + b, e);
+	e += a.lo*b;
+	p = quickTwoSum(p, e, e);
+	return DoubleDouble<T>(p, e);
+}
+
+template <typename T>
+static inline DoubleDouble<T> operator * (double a, const DoubleDouble<T>& b) {
+	return b * a;
+}
+
+template <typename T>
+static inline DoubleDouble<T> operator / (const DoubleDouble<T>& a, const DoubleDouble<T>& b) {
+	T q1 = a.hi / b.hi;
+	DoubleDouble<T> r = a - b * DoubleDouble<T>(q1, T());
+	T q2 = r.hi / b.hi;
+	T e;
+	q1 = quickTwoSum(q1, q2, e);
+	return DoubleDouble<T>(q1, e);
+}
+
+template <typename T>
+static inline DoubleDouble<T> operator / (double a, const DoubleDouble<T>& b) {
+	return DoubleDouble<T>(a) / b;
+}
+
+// comparisons against plain numbers, a mask per lane when T is a vector
+template <typename T>
+static inline auto operator < (const DoubleDouble<T>& a, double b) { return (a.hi < b) | ((a.hi == b) & (a.lo < 0)); }
+template <typename T>
+static inline auto operator <= (const DoubleDouble<T>& a, double b) { return (a.hi < b) | ((a.hi == b) & (a.lo <= 0)); }
+template <typename T>
+static inline auto operator > (const DoubleDouble<T>& a, double b) { return (a.hi > b) | ((a.hi == b) & (a.lo > 0)); }
+
+template <typename T>
+static inline DoubleDouble<T> abs(const DoubleDouble<T>& a) {
+	auto negative = a.hi < 0;
+	return DoubleDouble<T>(negative ? -a.hi : a.hi, negative ? -a.lo : a.lo);
+}
+
+template <typename T>
+static inline DoubleDouble<T> sqrt(const DoubleDouble<T>& a) {
+	if (a.hi <= 0) return DoubleDouble<T>();
+	T x = std::sqrt(a.hi);
+	T e;
+	T p = twoProd(x, x, e);
+	T r = ((a.hi - p) - e + a.lo) / (2*x);
+	x = quickTwoSum(x, r, e);
+	return DoubleDouble<T>(x, e);
+}
+
+typedef DoubleDouble<double> dd;
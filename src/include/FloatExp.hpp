@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <climits>
+
+// m * 2^e with a double mantissa, 0.5 <= |m| < 1, and a 64 bit exponent. Magnifications, pixel spacings
+// and the deltas of very deep frames go far below the smallest double; this keeps their 53 bits anyway.
+struct floatExp {
+	double m;
+	int64_t e;
+
+	floatExp(): m(0), e(0) {}
+
+	floatExp(double x) {
+		int k;
+		m = std::frexp(x, &k);
+		e = k;
+	}
+
+	floatExp(double mantissa, int64_t exponent) {
+		int k;
+		m = std::frexp(mantissa, &k);
+		e = m == 0 ? 0 : exponent + k;
+	}
+
+	// 0 below the smallest double, infinite above the largest
+	explicit operator double() const {
+		return std::ldexp(m, e < INT_MIN ? INT_MIN : e > INT_MAX ? INT_MAX : (int)e);
+	}
+
+	double log2() const {
+		return std::log2(std::fabs(m)) + e;
+	}
+};
+
+// The operations are static so that each kernel translation unit, built for its own instruction set, keeps its
+// own copy instead of the linker picking one for all of them.
+
+static inline floatExp operator - (const floatExp& a) {
+	floatExp r = a;
+	r.m = -a.m;
+	return r;
+}
+
+static inline floatExp operator * (const floatExp& a, const floatExp& b) {
+	return floatExp(a.m * b.m, a.e + b.e);
+}
+
+static inline floatExp& operator *= (floatExp& a, const floatExp& b) {
+	return a = a * b;
+}
+
+static inline floatExp operator / (const floatExp& a, const floatExp& b) {
+	return floatExp(a.m / b.m, a.e - b.e);
+}
+
+// the smaller operand is dropped once it is past the larger one's last bit
+static inline floatExp operator + (const floatExp& a, const floatExp& b) {
+	if (a.m == 0) return b;
+	if (b.m == 0) return a;
+
+	const floatExp& big = a.e >= b.e ? a : b;
+	const floatExp& small = a.e >= b.e ? b : a;
+	int64_t shift = big.e - small.e;
+	if (shift > 64) return big;
+
+	return floatExp(big.m + std::ldexp(small.m, -(int)shift), big.e);
+}
+
+static inline floatExp operator - (const floatExp& a, const floatExp& b) {
+	return a + -b;
+}
+
+static inline bool operator < (const floatExp& a, const floatExp& b) { return (a - b).m < 0; }
+static inline bool operator > (const floatExp& a, const floatExp& b) { return (a - b).m > 0; }
+static inline bool operator <= (const floatExp& a, const floatExp& b) { return (a - b).m <= 0; }
+static inline bool operator >= (const floatExp& a, const floatExp& b) { return (a - b).m >= 0; }
+
+static inline floatExp abs(const floatExp& a) {
+	floatExp r = a;
+	r.m = std::fabs(a.m);
+	return r;
+}
+
+static inline floatExp hypot(const floatExp& a, const floatExp& b) {
+	if (a.m == 0) return abs(b);
+	if (b.m == 0) return abs(a);
+
+	int64_t e = a.e > b.e ? a.e : b.e;
+	auto down = [e](const floatExp& x) { return e - x.e > 2000 ? 0.0 : std::ldexp(x.m, (int)(x.e - e)); };
+	return floatExp(std::hypot(down(a), down(b)), e);
+}
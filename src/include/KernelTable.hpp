@@ -0,0 +1,51 @@
+#pragma once
+
+// Body of the per instruction set translation units, define KERNEL_ISA before including
+#include <Dispatch.hpp>
+#include <Kernels.hpp>
+#include <PerturbationKernels.hpp>
+#include <type_traits>
+#include <utility>
+
+namespace KERNEL_ISA {
+
+static_assert(formulas::N == formulaN, "formulaN must match the formula list");
+static_assert(std::is_same<typeAt<burningShipOrbit, formulas>::type, burningShipFormula>::value, "orbit formulas must lead the formula list");
+
+template <int... F, int... P>
+constexpr kernelTable makeKernelTable(const char* name, std::integer_sequence<int, F...>, std::integer_sequence<int, P...>) {
+	return {
+		name,
+		{
+			{ escapeSpan<typename typeAt<F, formulas>::type, false, float>... },
+			{ escapeSpan<typename typeAt<F, formulas>::type, true, float>... }
+		},
+		{
+			{ escapeSpan<typename typeAt<F, formulas>::type, false, double>... },
+			{ escapeSpan<typename typeAt<F, formulas>::type, true, double>... }
+		},
+		{
+			{ escapeSpan<typename typeAt<F, formulas>::type, false, dd>... },
+			{ escapeSpan<typename typeAt<F, formulas>::type, true, dd>... }
+		},
+		{
+			{ perturbSpan<typename typeAt<P, formulas>::type, false, double>... },
+			{ perturbSpan<typename typeAt<P, formulas>::type, true, double>... }
+		},
+		{
+			{ blaSpan<typename typeAt<P, formulas>::type, false, double>... },
+			{ blaSpan<typename typeAt<P, formulas>::type, true, double>... }
+		},
+		{
+			{ perturbSpanExp<typename typeAt<P, formulas>::type, false, double>... },
+			{ perturbSpanExp<typename typeAt<P, formulas>::type, true, double>... }
+		},
+		colorSpan
+	};
+}
+
+constexpr kernelTable makeKernelTable(const char* name) {
+	return makeKernelTable(name, std::make_integer_sequence<int, formulaN>(), std::make_integer_sequence<int, orbitFormulaN>());
+}
+
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <Simd.hpp>
+#include <Complex.hpp>
+#include <DoubleDouble.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace KERNEL_ISA {
+
+// |x| for scalars, lane vectors and double-double lanes alike
+template <typename V>
+inline V vabs(V x) { return x < 0 ? -x : x; }
+
+template <typename T>
+inline DoubleDouble<T> vabs(const DoubleDouble<T>& x) { return abs(x); }
+
+// How a pixel coordinate of type T is spread across a register, one pixel per lane
+template <typename T>
+struct packOf {
+	typedef lanes<T> L;
+	typedef typename L::vec type;
+	typedef typename L::mvec mask;
+	static const int N = L::N;
+
+	static inline void set(type& v, int k, T x) { v[k] = x; }
+	static inline T get(const type& v, int k) { return v[k]; }
+	static inline type broadcast(T x) { return L::broadcast(x); }
+
+	// how close an orbit has to come back to where it was to count as periodic
+	static constexpr T periodTolerance = 8*std::numeric_limits<T>::epsilon();
+};
+
+template <>
+struct packOf<dd> {
+	typedef lanes<double> L;
+	typedef DoubleDouble<L::vec> type;
+	typedef L::mvec mask;
+	static const int N = L::N;
+
+	static inline void set(type& v, int k, dd x) { v.hi[k] = x.hi; v.lo[k] = x.lo; }
+	static inline dd get(const type& v, int k) { return dd(v.hi[k], v.lo[k]); }
+	static inline type broadcast(dd x) { return type(L::broadcast(x.hi), L::broadcast(x.lo)); }
+
+	static constexpr double periodTolerance = 0x1p-100;
+};
+
+// |c + d| - |c|, without the cancellation of subtracting them when d is much smaller than c
+template <typename C, typename D>
+inline D diffabs(C c, D d) {
+	D cd = d + c;
+	return c >= 0 ? (cd >= 0 ? d : -(d + 2*c)) : (cd > 0 ? d + 2*c : -d);
+}
+
+// Formulas advance z one iteration given the current squares and the constant c. Those that can be perturbed
+// also advance a pixel's delta dz from the reference orbit's Z, given the pixel's delta dc from its c.
+struct mandelbrotFormula { // standard mandelbrot set
+	template <typename V>
+	static inline void step(V& zr, V& zi, V zr2, V zi2, V cr, V ci) {
+		zi = 2*zr*zi + ci;
+		zr = zr2 - zi2 + cr;
+	}
+	template <typename V>
+	static inline auto bounded(V mod2) { return mod2 <= 4; }
+
+	// dz' = 2*Z*dz + dz^2 + dc
+	template <typename Z, typename V>
+	static inline void perturb(Z Zr, Z Zi, V& dr, V& di, V dcr, V dci) {
+		V tr = dr + 2*Zr, ti = di + 2*Zi;
+		V ndr = tr*dr - ti*di + dcr;
+		di = tr*di + ti*dr + dci;
+		dr = ndr;
+	}
+};
+
+struct burningShipFormula { // the burning ship
+	template <typename V>
+	static inline void step(V& zr, V& zi, V zr2, V zi2, V cr, V ci) {
+		zi = vabs(zr*zi*2) + ci;
+		zr = zr2 - zi2 + cr;
+	}
+	template <typename V>
+	static inline auto bounded(V mod2) { return mod2 < 4; }
+
+	// The real part is the mandelbrot set's, the imaginary part 2|zr*zi| - 2|Zr*Zi| + dc taken with diffabs,
+	// as zr*zi - Zr*Zi = Zr*di + Zi*dr + dr*di and the fold flips its sign wherever the two differ
+	template <typename Z, typename V>
+	static inline void perturb(Z Zr, Z Zi, V& dr, V& di, V dcr, V dci) {
+		V ndr = (dr + 2*Zr)*dr - (di + 2*Zi)*di + dcr;
+		di = 2*diffabs(Zr*Zi, dr*Zi + di*Zr + dr*di) + dci;
+		dr = ndr;
+	}
+};
+
+struct inverseCubeFormula { // z = 1/(z+c)^3
+	template <typename V>
+	static inline void step(V& zr, V& zi, V, V, V cr, V ci) {
+		Complex<V> z = ((Complex<V>(zr, zi) + Complex<V>(cr, ci)) ^ 3).reciprocal();
+		zr = z.R;
+		zi = z.I;
+	}
+	template <typename V>
+	static inline auto bounded(V mod2) { return mod2 < 4; }
+};
+
+// Inside the mandelbrot set's main cardioid or its period 2 bulb, in closed form
+template <typename V>
+inline auto cardioidOrBulb(V cr, V ci) {
+	V ci2 = ci*ci, xq = cr + -0.25, xb = cr + 1;
+	V q = xq*xq + ci2;
+	return (q*(q + xq) - 0.25*ci2 < 0) | (xb*xb + ci2 + -0.0625 < 0);
+}
+
+template <typename... F> struct typeList {
+	static const int N = sizeof...(F);
+};
+
+template <int n, typename List> struct typeAt {};
+template <typename F, typename... Rest> struct typeAt<0, typeList<F, Rest...>> { typedef F type; };
+template <int n, typename F, typename... Rest> struct typeAt<n, typeList<F, Rest...>> {
+	typedef typename typeAt<n-1, typeList<Rest...>>::type type;
+};
+
+// Registered formulas, in the order the V key cycles through them
+typedef typeList<mandelbrotFormula, burningShipFormula, inverseCubeFormula> formulas;
+
+// Escape time of n pixels at (px[k], py[k]), written to out[k].
+// In julia mode the pixel is the starting z and (jr, ji) is the constant.
+// Mandelbrot pixels in the cardioid or bulb skip the loop, and every pixel stops once its orbit comes back
+// within periodTolerance of where it was at the last power of two, Brent style. Both are written as interiorPixel.
+// When zr and zi are given, the z each pixel stopped at is written back to them, and a nonzero from resumes
+// pixels that were all still bounded after from iterations at that z rather than starting over.
+template <typename Formula, bool julia, typename T>
+void escapeSpan(const T* px, const T* py, T jr, T ji, int from, int imax, float* out, T* zr0, T* zi0, int n) {
+	typedef packOf<T> P;
+	typedef typename P::type vec;
+	typedef typename P::mask mvec;
+	bool resume = from > 0 && zr0 != NULL;
+
+	for (int k0 = 0; k0 < n; k0 += P::N) {
+		vec x, y, zr = P::broadcast(T()), zi = P::broadcast(T());
+		for (int k = 0; k < P::N; k++) {
+			int j = k0 + k < n ? k0 + k : n - 1; // repeat the last pixel to fill a partial span
+			P::set(x, k, px[j]);
+			P::set(y, k, py[j]);
+			if (resume) {
+				P::set(zr, k, zr0[j]);
+				P::set(zi, k, zi0[j]);
+			}
+		}
+
+		vec cr = julia ? P::broadcast(jr) : x;
+		vec ci = julia ? P::broadcast(ji) : y;
+		if (julia && !resume) {
+			zr = x;
+			zi = y;
+		}
+
+		vec zr2 = zr*zr,
+		    zi2 = zi*zi;
+
+		mvec interior = mvec{};
+		if (std::is_same<Formula, mandelbrotFormula>::value && !julia && !resume) interior = cardioidOrBulb(cr, ci);
+
+		mvec active = ~interior;
+		mvec count = mvec{} + (resume ? from : 0);
+		vec sr = zr, si = zi;
+		int saveAt = resume ? from + 1 : 1;
+
+		for (int i = resume ? from : 0; i < imax; i++) {
+			active &= Formula::bounded(zr2 + zi2);
+			if (!P::L::any(active)) break;
+			count -= active;
+
+			Formula::step(zr, zi, zr2, zi2, cr, ci);
+			zr2 = zr*zr;
+			zi2 = zi*zi;
+
+			mvec periodic = active & (vabs(zr - sr) < P::periodTolerance) & (vabs(zi - si) < P::periodTolerance);
+			interior |= periodic;
+			active &= ~periodic;
+
+			if (i == saveAt) {
+				sr = zr;
+				si = zi;
+				saveAt *= 2;
+			}
+		}
+
+		for (int k = 0; k < P::N && k0 + k < n; k++) {
+			out[k0 + k] = interior[k] ? interiorPixel : count[k];
+			if (zr0 != NULL) {
+				zr0[k0 + k] = P::get(zr, k);
+				zi0[k0 + k] = P::get(zi, k);
+			}
+		}
+	}
+}
+
+// Colours of n escape times from a palette of paletteSize + 1, one 32 bit RGBA word each. Count i takes colour
+// i*paletteSize/imax, interior pixels and counts past imax the last one. A register of palette indices at a
+// time, looked up with one gather on AVX2 and AVX-512 and lane by lane below that.
+inline void colorSpan(const float* iters, const uint32_t* palette, int imax, uint32_t* out, int n) {
+	typedef lanes<float> L;
+	typedef L::mvec ivec;
+	float scale = (float)paletteSize / imax;
+	int k0 = 0;
+
+	for (; k0 + L::N <= n; k0 += L::N) {
+		L::vec i;
+		std::memcpy(&i, iters + k0, sizeof(i));
+		ivec index = __builtin_convertvector(i * scale, ivec);
+		ivec inside = (i >= 0) & (i < (float)imax) & (index < paletteSize);
+		index = (index & inside) | (paletteSize & ~inside);
+		ivec colors = L::gather((const int32_t*)palette, index);
+		std::memcpy(out + k0, &colors, sizeof(colors));
+	}
+
+	for (; k0 < n; k0++) {
+		float i = iters[k0];
+		out[k0] = palette[i >= 0 && i < imax ? std::min((int)(i * scale), paletteSize) : paletteSize];
+	}
+}
+
+}
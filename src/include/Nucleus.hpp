@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cmath>
+#include <BigFloat.hpp>
+#include <FloatExp.hpp>
+
+// Newton's method on the periodic points of the mandelbrot set, to find the nucleus of the minibrot whose
+// atom domain holds a point and how large that minibrot is
+
+// Complex numbers of floatExp parts, for derivatives and sizes that leave double range at deep zooms
+struct expComplex {
+	floatExp r, i;
+
+	friend expComplex operator + (const expComplex& a, const expComplex& b) {
+		return expComplex{ a.r + b.r, a.i + b.i };
+	}
+
+	friend expComplex operator * (const expComplex& a, const expComplex& b) {
+		return expComplex{ a.r*b.r - a.i*b.i, a.r*b.i + a.i*b.r };
+	}
+
+	friend expComplex operator / (const expComplex& a, const expComplex& b) {
+		floatExp n = b.r*b.r + b.i*b.i;
+		return expComplex{ (a.r*b.r + a.i*b.i) / n, (a.i*b.r - a.r*b.i) / n };
+	}
+};
+
+// z = z^2 + c in place, t being scratch
+inline void nucleusStep(BigFloat& zr, BigFloat& zi, const BigFloat& cr, const BigFloat& ci, BigFloat& zr2, BigFloat& zi2, BigFloat& t) {
+	BigFloat::sqr(zr2, zr);
+	BigFloat::sqr(zi2, zi);
+	BigFloat::add(t, zr, zi);
+	BigFloat::sqr(t, t);
+	BigFloat::sub(t, t, zr2);
+	BigFloat::sub(t, t, zi2);
+	BigFloat::add(zi, t, ci);
+	BigFloat::sub(zr, zr2, zi2);
+	BigFloat::add(zr, zr, cr);
+}
+
+// Period of the atom domain (cr, ci) lies in: the last n up to imax at which |z_n| was the smallest yet, before
+// the orbit escaped. Returns 0 when c escapes at once.
+inline int atomPeriod(const BigFloat& cr, const BigFloat& ci, int imax) {
+	int bits = cr.precision();
+	BigFloat zr(0.0, bits), zi(0.0, bits), zr2, zi2, t;
+	floatExp smallest;
+	int period = 0;
+
+	for (int n = 1; n <= imax; n++) {
+		nucleusStep(zr, zi, cr, ci, zr2, zi2, t);
+
+		floatExp mod2 = floatExp(zr)*floatExp(zr) + floatExp(zi)*floatExp(zi);
+		if (mod2 > 4) break;
+		if (period == 0 || mod2 < smallest) {
+			smallest = mod2;
+			period = n;
+		}
+	}
+
+	return period;
+}
+
+// z_n(c) and its derivative dz/dc, which follows z as dz' = 2 z dz + 1. Returns the first n up to period that
+// divides it and has z_n within rounding of 0, which at a nucleus is its true period.
+inline int periodicPoint(const BigFloat& cr, const BigFloat& ci, int period, BigFloat& zr, BigFloat& zi, expComplex& dz) {
+	int bits = cr.precision();
+	BigFloat zr2, zi2, t;
+	floatExp scale = hypot(floatExp(cr), floatExp(ci));
+	zr = BigFloat(0.0, bits);
+	zi = BigFloat(0.0, bits);
+	dz = expComplex{ floatExp(), floatExp() };
+
+	for (int n = 1; n <= period; n++) {
+		expComplex z = { floatExp(zr), floatExp(zi) };
+		dz = expComplex{ 2.0, 0.0 } * z * dz + expComplex{ 1.0, 0.0 };
+		nucleusStep(zr, zi, cr, ci, zr2, zi2, t);
+
+		floatExp rounding = hypot(dz.r, dz.i) * scale * floatExp(1.0, 16 - bits);
+		if (period % n == 0 && hypot(floatExp(zr), floatExp(zi)) < rounding) return n;
+	}
+
+	return period;
+}
+
+// Moves (cr, ci) onto a root of z_period(c) = 0 by Newton's method and lowers period to the root's true one,
+// a root of z_period also being one of z_n for every n dividing it. Stops once a step is below the last few
+// bits of c, false if the steps blow up or never get there.
+inline bool nucleusNewton(BigFloat& cr, BigFloat& ci, int& period) {
+	const int maxSteps = 64;
+	int bits = cr.precision();
+	BigFloat zr, zi;
+	expComplex dz;
+
+	for (int step = 0; step < maxSteps; step++) {
+		int divisor = periodicPoint(cr, ci, period, zr, zi, dz);
+		if (divisor < period) {
+			period = divisor;
+			return true;
+		}
+
+		expComplex delta = expComplex{ floatExp(zr), floatExp(zi) } / dz;
+		if (!std::isfinite(delta.r.m) || !std::isfinite(delta.i.m)) return false;
+
+		BigFloat::sub(cr, cr, BigFloat(delta.r, bits));
+		BigFloat::sub(ci, ci, BigFloat(delta.i, bits));
+
+		floatExp moved = hypot(delta.r, delta.i), scale = hypot(floatExp(cr), floatExp(ci));
+		if (moved.m == 0 || scale.m == 0 || moved.log2() < scale.log2() - bits + 8) return true;
+	}
+
+	return false;
+}
+
+// Scale of the minibrot with this nucleus against the whole set, |1 / (b l^2)| where l is the product of
+// 2 z_n and b the sum of 1/l over the orbit's first period - 1 steps
+inline floatExp nucleusSize(const BigFloat& cr, const BigFloat& ci, int period) {
+	int bits = cr.precision();
+	BigFloat zr(0.0, bits), zi(0.0, bits), zr2, zi2, t;
+	expComplex l = { 1.0, 0.0 }, b = { 1.0, 0.0 };
+
+	for (int n = 1; n < period; n++) {
+		nucleusStep(zr, zi, cr, ci, zr2, zi2, t);
+		l = expComplex{ 2.0, 0.0 } * expComplex{ floatExp(zr), floatExp(zi) } * l;
+		b = b + expComplex{ 1.0, 0.0 } / l;
+	}
+
+	expComplex s = expComplex{ 1.0, 0.0 } / (b * l * l);
+	return hypot(s.r, s.i);
+}
+
+// Nucleus of the given period near (cr, ci), its true period and its minibrot's size. The precision of c grows
+// until it resolves the minibrot with bits to spare, re-running Newton from where the last round stopped.
+inline bool locateNucleus(BigFloat& cr, BigFloat& ci, int& period, floatExp& size) {
+	const int maxRounds = 4, spareBits = 64;
+
+	for (int round = 0; round < maxRounds; round++) {
+		if (!nucleusNewton(cr, ci, period)) return false;
+
+		size = nucleusSize(cr, ci, period);
+		int needed = std::ceil(-size.log2()) + spareBits;
+		if (needed <= cr.precision()) return true;
+
+		cr.setPrecision(needed);
+		ci.setPrecision(needed);
+	}
+
+	return true;
+}
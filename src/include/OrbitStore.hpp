@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// One stored iterate of a compressed reference orbit
+struct orbitWaypoint {
+	int i;
+	double zr, zi;
+};
+
+// Growable array of waypoints, kept in memory or spilled to a memory mapped temporary file that the OS can
+// page out instead of swapping. Files go to the directory named by MANDELBROT_ORBIT_SPILL, when it is set.
+class waypointStore {
+	public:
+		waypointStore();
+
+		~waypointStore();
+
+		waypointStore(const waypointStore&) = delete;
+		waypointStore& operator = (const waypointStore&) = delete;
+
+		// Empties the store. The next waypoint pushed spills it if the environment asks for that.
+		void clear();
+
+		void push(const orbitWaypoint& w);
+
+		const orbitWaypoint* data() const {
+			return mapped != NULL ? mapped : memory.data();
+		}
+
+		int size() const {
+			return count;
+		}
+
+		bool spilled() const {
+			return mapped != NULL;
+		}
+
+	private:
+		std::vector<orbitWaypoint> memory;
+		orbitWaypoint* mapped;
+		size_t count, capacity;
+		void* file;
+
+		void spill();
+		bool map(size_t newCapacity);
+		void unmap();
+};
+
+// z^2 + c in doubles, or the burning ship's step, which is how compressed orbits are filled in between
+// waypoints. Out of line so the code that picks the waypoints and every kernel build that regenerates from them
+// run the same instructions; a kernel built with FMA could otherwise contract it and round differently.
+void regenerateStep(double& zr, double& zi, double cr, double ci, bool ship);
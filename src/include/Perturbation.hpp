@@ -0,0 +1,411 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <BigFloat.hpp>
+#include <OrbitStore.hpp>
+
+// Written in place of an escape time for pixels whose delta lost track of the reference orbit
+const float glitchedPixel = -1.0f;
+
+// Pauldelbrot's criterion: |Z + dz|^2 below this fraction of |Z|^2 means the pixel's orbit is no longer
+// close enough to the reference for its delta to keep enough precision
+const double glitchTolerance = 1e-6;
+
+// Orbits from this many iterations on are stored compressed, at 16 bytes an iterate they would take 256 MB
+const int compressedOrbitIterations = 1 << 24;
+
+// A compressed orbit stores an iterate when regenerating it in doubles from the previous waypoint is off
+// by more than this fraction of its size. Orbits that keep coming back near 0, as around minibrots, lose that
+// much every period: a period 3 nucleus keeps every third iterate and points near the boundary about one in
+// four. At 24 bytes a waypoint that is a third to a half of the full orbit's size. Orbits that wander slowly
+// compress far better, c = 0.25 keeps under 1% of its iterates.
+const double waypointTolerance = 0x1p-50;
+
+// Formulas with a delta recurrence, numbered as in the kernels' formula list
+enum orbitFormula {
+	mandelbrotOrbit,
+	burningShipOrbit
+};
+
+const int orbitFormulaN = 2;
+
+// Orbit of a single high precision reference point, rounded to double for the delta kernels. Mandelbrot
+// orbits start at 0 with c the point, Julia orbits at the point with c the set's constant. Compressed orbits
+// keep only the waypoints and the formula is iterated in doubles, with c rounded, to fill in the rest.
+struct referenceOrbit {
+	std::vector<double> zr, zi;
+	waypointStore waypoints;
+	double cr = 0, ci = 0;
+	int iterations = 0;
+	bool compressed = false;
+	orbitFormula formula = mandelbrotOrbit;
+	bool julia = false;
+
+	// Where extendReference carries on from: the full precision iterate after the last one stored, unless
+	// the last one escaped
+	BigFloat nextr, nexti;
+	bool escaped = false;
+
+	int length() const {
+		return iterations;
+	}
+
+	void start(double _cr, double _ci, bool compress, orbitFormula _formula, bool _julia) {
+		zr.clear();
+		zi.clear();
+		waypoints.clear();
+		cr = _cr;
+		ci = _ci;
+		iterations = 0;
+		compressed = compress;
+		formula = _formula;
+		julia = _julia;
+		nr = ni = 0;
+		nextr = nexti = 0.0;
+		escaped = false;
+	}
+
+	void push(double r, double i) {
+		if (!compressed) {
+			zr.push_back(r);
+			zi.push_back(i);
+		} else {
+			if (iterations == 0 || std::hypot(nr - r, ni - i) > waypointTolerance*std::hypot(r, i)) {
+				waypoints.push(orbitWaypoint{ iterations, r, i });
+				nr = r;
+				ni = i;
+			}
+			regenerate(nr, ni);
+		}
+		iterations++;
+	}
+
+	// One step of the formula in doubles, how compressed orbits fill in between waypoints
+	void regenerate(double& r, double& i) const {
+		regenerateStep(r, i, cr, ci, formula == burningShipOrbit);
+	}
+
+	// Walks the orbit from its start one iterate at a time
+	class reader {
+		public:
+			double zr, zi;
+
+			reader(const referenceOrbit& _orbit): orbit(_orbit), m(0), next(1) {
+				zr = orbit.compressed ? orbit.waypoints.data()[0].zr : orbit.zr[0];
+				zi = orbit.compressed ? orbit.waypoints.data()[0].zi : orbit.zi[0];
+			}
+
+			void step() {
+				m++;
+				if (!orbit.compressed) {
+					zr = orbit.zr[m];
+					zi = orbit.zi[m];
+				} else if (next < orbit.waypoints.size() && orbit.waypoints.data()[next].i == m) {
+					zr = orbit.waypoints.data()[next].zr;
+					zi = orbit.waypoints.data()[next].zi;
+					next++;
+				} else {
+					orbit.regenerate(zr, zi);
+				}
+			}
+
+		private:
+			const referenceOrbit& orbit;
+			int m, next;
+	};
+
+	private:
+		double nr = 0, ni = 0; // what the reader will regenerate for the next iterate
+};
+
+// Carries the orbit of (cr, ci) on from where it stopped, in precision H, until it escapes or imax+1 values
+// are stored
+template <typename H>
+void extendReference(referenceOrbit& orbit, const H& cr, const H& ci, int imax) {
+	using std::abs;
+	if (orbit.escaped) return;
+
+	H zr = H(orbit.nextr), zi = H(orbit.nexti);
+
+	for (int i = orbit.length(); i <= imax; i++) {
+		orbit.push(double(zr), double(zi));
+
+		H zr2 = zr*zr, zi2 = zi*zi;
+		if (zr2 + zi2 > 4) {
+			orbit.escaped = true;
+			return;
+		}
+
+		zi = orbit.formula == burningShipOrbit ? abs(2*zr*zi) + ci : 2*zr*zi + ci;
+		zr = zr2 - zi2 + cr;
+	}
+
+	orbit.nextr = BigFloat(zr);
+	orbit.nexti = BigFloat(zi);
+}
+
+// From this precision the reference orbit's three squares per step go to three threads. Two of them off the
+// calling thread save 2.4 us a step at 2048 bits but 0.7 us at 1024, where a handoff's two cache line round trips
+// would eat much of it. make bench prints the crossover for the machine it runs on.
+const int parallelReferenceBits = 2048;
+
+// Same at the precision of (cr, ci), in place so the limbs are not reallocated every iteration.
+// 2*zr*zi is taken as (zr + zi)^2 - zr^2 - zi^2, three squarings being cheaper than two and a multiply.
+// They are independent, so with parallel set and enough bits each step squares on three threads.
+inline void extendReference(referenceOrbit& orbit, const BigFloat& cr, const BigFloat& ci, int imax, bool parallel = false) {
+	if (orbit.escaped) return;
+
+	int bits = std::max(cr.precision(), ci.precision());
+	BigFloat zr = orbit.nextr, zi = orbit.nexti, zr2, zi2, t;
+	zr.setPrecision(bits);
+	zi.setPrecision(bits);
+
+	squaringTeam team(parallel && bits >= parallelReferenceBits ? 3 : 1);
+	BigFloat* const squares[] = { &zr2, &zi2, &t };
+	const BigFloat* const roots[] = { &zr, &zi, &t };
+
+	for (int i = orbit.length(); i <= imax; i++) {
+		orbit.push(double(zr), double(zi));
+
+		BigFloat::add(t, zr, zi);
+		team.sqr(squares, roots, 3);
+		if (double(zr2) + double(zi2) > 4) {
+			orbit.escaped = true;
+			return;
+		}
+
+		BigFloat::sub(t, t, zr2);
+		BigFloat::sub(t, t, zi2);
+		if (orbit.formula == burningShipOrbit) BigFloat::abs(t, t);
+		BigFloat::add(zi, t, ci);
+
+		BigFloat::sub(zr, zr2, zi2);
+		BigFloat::add(zr, zr, cr);
+	}
+
+	orbit.nextr = zr;
+	orbit.nexti = zi;
+}
+
+// Iterates the formula at (cr, ci) from 0 until it escapes or imax+1 values are stored
+template <typename H>
+void computeReference(referenceOrbit& orbit, const H& cr, const H& ci, int imax, bool compress = false, orbitFormula formula = mandelbrotOrbit) {
+	orbit.start(double(cr), double(ci), compress, formula, false);
+	extendReference(orbit, cr, ci, imax);
+}
+
+inline void computeReference(referenceOrbit& orbit, const BigFloat& cr, const BigFloat& ci, int imax, bool compress = false,
+	orbitFormula formula = mandelbrotOrbit, bool parallel = false) {
+	orbit.start(double(cr), double(ci), compress, formula, false);
+	extendReference(orbit, cr, ci, imax, parallel);
+}
+
+// Iterates the formula with constant (cr, ci) from the point (zr, zi), for Julia sets
+template <typename H>
+void computeJuliaReference(referenceOrbit& orbit, const H& zr, const H& zi, const H& cr, const H& ci, int imax, bool compress = false,
+	orbitFormula formula = mandelbrotOrbit) {
+	orbit.start(double(cr), double(ci), compress, formula, true);
+	orbit.nextr = BigFloat(zr);
+	orbit.nexti = BigFloat(zi);
+	extendReference(orbit, cr, ci, imax);
+}
+
+inline void computeJuliaReference(referenceOrbit& orbit, const BigFloat& zr, const BigFloat& zi, const BigFloat& cr, const BigFloat& ci, int imax,
+	bool compress = false, orbitFormula formula = mandelbrotOrbit, bool parallel = false) {
+	orbit.start(double(cr), double(ci), compress, formula, true);
+	orbit.nextr = zr;
+	orbit.nexti = zi;
+	extendReference(orbit, cr, ci, imax, parallel);
+}
+
+// dz_skip ~ A dc + B dc^2 + C dc^3 for every pixel within the radius it was fitted for. For Julia sets dc is
+// the pixel's offset from the orbit's starting point, so dz_0 = dc.
+struct seriesApproximation {
+	int skip;
+	double ar, ai, br, bi, cr, ci;
+};
+
+// The series for skipping nothing
+inline seriesApproximation noSeries(bool julia) {
+	return seriesApproximation{ 0, julia ? 1.0 : 0.0, 0, 0, 0, 0, 0 };
+}
+
+// Series coefficients one iteration further along, at Z. Julia sets have no dc term, A' = 2ZA.
+inline seriesApproximation seriesStep(const seriesApproximation& s, double zr, double zi, bool julia) {
+	seriesApproximation t;
+	t.skip = s.skip + 1;
+	t.ar = 2*(zr*s.ar - zi*s.ai) + (julia ? 0 : 1);
+	t.ai = 2*(zr*s.ai + zi*s.ar);
+	t.br = 2*(zr*s.br - zi*s.bi) + s.ar*s.ar - s.ai*s.ai;
+	t.bi = 2*(zr*s.bi + zi*s.br) + 2*s.ar*s.ai;
+	t.cr = 2*(zr*s.cr - zi*s.ci) + 2*(s.ar*s.br - s.ai*s.bi);
+	t.ci = 2*(zr*s.ci + zi*s.cr) + 2*(s.ar*s.bi + s.ai*s.br);
+	return t;
+}
+
+// Runs the series coefficients along the orbit, A' = 2ZA + 1, B' = 2ZB + A^2, C' = 2ZC + 2AB, and stops
+// where the cubic term stops being negligible at the frame's radius. Probe pixels on the frame's edge are
+// then iterated directly and the skip is backed off until the series agrees with them. Only the current
+// coefficients are kept, backing off reruns them from the start, so long orbits cost no memory here.
+inline seriesApproximation approximateSeries(const referenceOrbit& orbit, double radius, int imax) {
+	const double truncation = 1e-12, agreement = 1e-6;
+	const seriesApproximation none = noSeries(orbit.julia);
+
+	int last = std::min(orbit.length(), imax) - 1;
+	seriesApproximation longest = none;
+
+	referenceOrbit::reader z(orbit);
+	for (int n = 0; n < last; n++, z.step()) {
+		seriesApproximation t = seriesStep(longest, z.zr, z.zi, orbit.julia);
+
+		double a = std::hypot(t.ar, t.ai), c = std::hypot(t.cr, t.ci);
+		if (!(c*radius*radius*radius < truncation*a*radius)) break;
+
+		longest = t;
+	}
+
+	const double probes[8][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1}, {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+
+	for (int skip = longest.skip; skip > 0; skip = skip*3/4) {
+		seriesApproximation s = longest;
+		if (skip < longest.skip) {
+			s = none;
+			referenceOrbit::reader z(orbit);
+			for (int n = 0; n < skip; n++, z.step()) s = seriesStep(s, z.zr, z.zi, orbit.julia);
+		}
+		bool valid = true;
+
+		for (int p = 0; p < 8 && valid; p++) {
+			double dcr = probes[p][0]*radius, dci = probes[p][1]*radius;
+			double dr = orbit.julia ? dcr : 0, di = orbit.julia ? dci : 0;
+			double addr = orbit.julia ? 0 : dcr, addi = orbit.julia ? 0 : dci;
+
+			referenceOrbit::reader z(orbit);
+			for (int n = 0; n < skip; n++, z.step()) {
+				double tr = 2*z.zr + dr, ti = 2*z.zi + di;
+				double ndr = tr*dr - ti*di + addr;
+				di = tr*di + ti*dr + addi;
+				dr = ndr;
+			}
+
+			double c2r = dcr*dcr - dci*dci, c2i = 2*dcr*dci;
+			double c3r = c2r*dcr - c2i*dci, c3i = c2r*dci + c2i*dcr;
+			double sr = s.ar*dcr - s.ai*dci + s.br*c2r - s.bi*c2i + s.cr*c3r - s.ci*c3i;
+			double si = s.ar*dci + s.ai*dcr + s.br*c2i + s.bi*c2r + s.cr*c3i + s.ci*c3r;
+
+			valid = std::hypot(sr - dr, si - di) <= agreement*std::hypot(dr, di);
+		}
+
+		if (valid) return s;
+	}
+
+	return none;
+}
+
+// Jumps l iterations at once, dz -> A dz + B dc, valid while |dz| < r
+struct blaStep {
+	double ar, ai, br, bi, r;
+	int l;
+};
+
+// Compressed orbits' BLA tables start from steps of 2^this iterations, so the table has about one entry for
+// every 32 iterations of the orbit instead of two for each
+const int compressedBLALevel = 6;
+
+// Level k holds the merged steps of 2^k iterations starting at m = 1 + j*2^k. Tables of compressed orbits leave
+// the levels below base empty and keep Z at the start of each step of level base as anchors, m = 1 + j*2^base,
+// so a jump lands there without regenerating the orbit from the waypoint before it.
+struct blaTable {
+	std::vector<blaStep> steps;
+	std::vector<int> levelStart;
+	int base = 0;
+	std::vector<orbitWaypoint> anchors;
+
+	int levels() const {
+		return levelStart.empty() ? 0 : levelStart.size() - 1;
+	}
+};
+
+// Single steps are linear while dz^2 is below epsilon of 2*Z*dz
+inline blaStep singleBLA(double zr, double zi, double radius) {
+	const double epsilon = 0x1p-53;
+
+	double ar = 2*zr, ai = 2*zi;
+	double a = std::hypot(ar, ai);
+	return blaStep{ ar, ai, 1, 0, std::max(0.0, (epsilon*a - radius) / (a + 1)), 1 };
+}
+
+// x then y: A = Ay*Ax, B = Ay*Bx + By, r = min(rx, (ry - |Bx|*radius)/|Ax|), radius being the largest |dc| in the frame
+inline blaStep mergeBLA(const blaStep& x, const blaStep& y, double radius) {
+	blaStep z;
+	z.ar = y.ar*x.ar - y.ai*x.ai;
+	z.ai = y.ar*x.ai + y.ai*x.ar;
+	z.br = y.ar*x.br - y.ai*x.bi + y.br;
+	z.bi = y.ar*x.bi + y.ai*x.br + y.bi;
+	z.r = std::max(0.0, std::min(x.r, (y.r - std::hypot(x.br, x.bi)*radius) / std::hypot(x.ar, x.ai)));
+	z.l = x.l + y.l;
+	return z;
+}
+
+// Compressed orbits are read once, front to back, each step of the base level merged as its iterates go by
+inline void buildBLA(blaTable& table, const referenceOrbit& orbit, double radius) {
+	table.steps.clear();
+	table.levelStart.assign(1, 0);
+	table.anchors.clear();
+	table.base = orbit.compressed ? compressedBLALevel : 0;
+
+	if (!orbit.compressed) {
+		for (int m = 1; m + 1 < orbit.length(); m++) table.steps.push_back(singleBLA(orbit.zr[m], orbit.zi[m], radius));
+	} else {
+		int span = 1 << table.base;
+		table.levelStart.assign(table.base + 1, 0);
+
+		referenceOrbit::reader z(orbit);
+		z.step();
+		for (int m = 1; m + span < orbit.length(); m += span) {
+			table.anchors.push_back(orbitWaypoint{ m, z.zr, z.zi });
+			blaStep step = singleBLA(z.zr, z.zi, radius);
+			z.step();
+			for (int k = 1; k < span; k++, z.step()) step = mergeBLA(step, singleBLA(z.zr, z.zi, radius), radius);
+			table.steps.push_back(step);
+		}
+	}
+	table.levelStart.push_back(table.steps.size());
+
+	for (int k = table.base + 1; table.levelStart[k] - table.levelStart[k-1] > 1; k++) {
+		for (int j = table.levelStart[k-1]; j + 1 < table.levelStart[k]; j += 2) {
+			table.steps.push_back(mergeBLA(table.steps[j], table.steps[j+1], radius));
+		}
+		table.levelStart.push_back(table.steps.size());
+	}
+}
+
+// Everything the delta kernels read for one frame, as plain arrays. Compressed orbits leave Zr and Zi
+// NULL and pass their waypoints and rounded c instead.
+struct perturbationFrame {
+	const double* Zr;
+	const double* Zi;
+	const orbitWaypoint* waypoints;
+	int waypointCount;
+	double cr, ci;
+	int orbitLength;
+	seriesApproximation series;
+	const blaStep* bla;
+	const int* blaLevelStart;
+	int blaLevels;
+	const orbitWaypoint* blaAnchors;
+	int blaAnchorCount, blaBase;
+	bool rebase;
+};
+
+// Julia orbits start away from 0, so their pixels can't restart at the top of the orbit and are never rebased
+inline perturbationFrame frameOf(const referenceOrbit& orbit, const seriesApproximation& series, const blaTable& bla, bool rebase) {
+	return perturbationFrame{
+		orbit.compressed ? NULL : orbit.zr.data(), orbit.compressed ? NULL : orbit.zi.data(),
+		orbit.waypoints.data(), orbit.waypoints.size(), orbit.cr, orbit.ci, orbit.length(),
+		series, bla.steps.data(), bla.levelStart.data(), bla.levels(), bla.anchors.data(), (int)bla.anchors.size(), bla.base,
+		rebase && !orbit.julia
+	};
+}
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <Kernels.hpp>
+#include <FloatExp.hpp>
+
+namespace KERNEL_ISA {
+
+// Position m on the frame's reference orbit and Z_m there. Compressed orbits are regenerated in doubles from
+// the last waypoint or BLA anchor at or before m, taking each later waypoint as it is reached, with the same
+// regenerateStep that chose the waypoints.
+template <typename Formula>
+class orbitCursor {
+	public:
+		int m;
+		double zr, zi;
+
+		orbitCursor(const perturbationFrame& _frame, int _m): frame(_frame) {
+			to(_m);
+		}
+
+		void to(int target) {
+			if (frame.Zr != NULL) {
+				m = target;
+				zr = frame.Zr[m];
+				zi = frame.Zi[m];
+				return;
+			}
+
+			int lo = 0, hi = frame.waypointCount;
+			while (hi - lo > 1) {
+				int mid = (lo + hi) / 2;
+				if (frame.waypoints[mid].i <= target) lo = mid;
+				else hi = mid;
+			}
+
+			m = frame.waypoints[lo].i;
+			zr = frame.waypoints[lo].zr;
+			zi = frame.waypoints[lo].zi;
+			next = lo + 1;
+
+			// a BLA anchor past that waypoint is a shorter way in, and holds what regenerating would give there
+			if (frame.blaAnchorCount > 0 && target > 0) {
+				int j = std::min((target - 1) >> frame.blaBase, frame.blaAnchorCount - 1);
+				if (frame.blaAnchors[j].i > m) {
+					m = frame.blaAnchors[j].i;
+					zr = frame.blaAnchors[j].zr;
+					zi = frame.blaAnchors[j].zi;
+				}
+			}
+			while (m < target) step();
+		}
+
+		// Past the end of the orbit m still counts up but Z is left as it was
+		void step() {
+			m++;
+			if (m >= frame.orbitLength) return;
+
+			if (frame.Zr != NULL) {
+				zr = frame.Zr[m];
+				zi = frame.Zi[m];
+			} else if (next < frame.waypointCount && frame.waypoints[next].i == m) {
+				zr = frame.waypoints[next].zr;
+				zi = frame.waypoints[next].zi;
+				next++;
+			} else {
+				regenerateStep(zr, zi, frame.cr, frame.ci, std::is_same<Formula, burningShipFormula>::value);
+			}
+		}
+
+	private:
+		const perturbationFrame& frame;
+		int next = 0;
+};
+
+// dz after the first series.skip iterations, from the series evaluated at dc
+template <typename V>
+inline void seriesDelta(const seriesApproximation& s, V dcx, V dcy, V& dr, V& di) {
+	V c2r = dcx*dcx - dcy*dcy, c2i = 2*dcx*dcy;
+	V c3r = c2r*dcx - c2i*dcy, c3i = c2r*dcy + c2i*dcx;
+	dr = s.ar*dcx - s.ai*dcy + s.br*c2r - s.bi*c2i + s.cr*c3r - s.ci*c3i;
+	di = s.ar*dcy + s.ai*dcx + s.br*c2i + s.bi*c2r + s.cr*c3i + s.ci*c3r;
+}
+
+// Escape time of n pixels at c = C + (dcr[k], dci[k]), iterated as deltas from the reference orbit Z of C
+// with the formula's delta recurrence, the pixel's z being Z + dz. The first series.skip iterations are
+// replaced by evaluating the series at dc. For Julia sets dc is the pixel's offset from the orbit's starting
+// point instead, which only enters through the series, and c is the same for every pixel. Pixels that meet
+// the glitch criterion, or are still bounded when the orbit runs out before imax, are written as glitchedPixel.
+template <typename Formula, bool julia, typename T>
+void perturbSpanFixed(const perturbationFrame& frame, const T* dcr, const T* dci, int imax, float* out, int n) {
+	typedef packOf<T> P;
+	typedef typename P::type vec;
+	typedef typename P::mask mvec;
+
+	const T* Zr = frame.Zr;
+	const T* Zi = frame.Zi;
+	const seriesApproximation& series = frame.series;
+	int iterations = imax < frame.orbitLength ? imax : frame.orbitLength;
+
+	for (int k0 = 0; k0 < n; k0 += P::N) {
+		vec dcx, dcy;
+		for (int k = 0; k < P::N; k++) {
+			int j = k0 + k < n ? k0 + k : n - 1;
+			P::set(dcx, k, dcr[j]);
+			P::set(dcy, k, dci[j]);
+		}
+
+		vec dr, di;
+		seriesDelta(series, dcx, dcy, dr, di);
+		if (julia) dcx = dcy = vec{};
+
+		mvec active = mvec{} - 1;
+		mvec glitched = mvec{};
+		mvec count = mvec{} + series.skip;
+
+		for (int i = series.skip; i < iterations; i++) {
+			T Zri = Zr[i], Zii = Zi[i];
+			vec zr = Zri + dr, zi = Zii + di;
+			vec mod2 = zr*zr + zi*zi;
+
+			active &= Formula::bounded(mod2);
+			glitched |= active & (mod2 < glitchTolerance*(Zri*Zri + Zii*Zii));
+			active &= ~glitched;
+			if (!P::L::any(active)) break;
+			count -= active;
+
+			Formula::perturb(Zri, Zii, dr, di, dcx, dcy);
+		}
+
+		if (iterations < imax) glitched |= active;
+
+		for (int k = 0; k < P::N && k0 + k < n; k++) {
+			out[k0 + k] = glitched[k] ? glitchedPixel : count[k];
+		}
+	}
+}
+
+// Same escape times with each lane at its own position m on the orbit. A pixel restarts from the beginning of
+// the orbit, dz = Z_m + dz and m = 0, once it is closer to 0 than dz is or the reference has escaped, so it
+// never drifts far enough from the reference to glitch. Returns how many rebases happened.
+template <typename Formula, bool julia, typename T>
+long long perturbSpanRebased(const perturbationFrame& frame, const T* dcr, const T* dci, int imax, float* out, int n) {
+	typedef packOf<T> P;
+	typedef typename P::type vec;
+	typedef typename P::mask mvec;
+
+	const T* Zr = frame.Zr;
+	const T* Zi = frame.Zi;
+	const seriesApproximation& series = frame.series;
+	int last = frame.orbitLength - 1;
+	long long rebases = 0;
+
+	for (int k0 = 0; k0 < n; k0 += P::N) {
+		vec dcx, dcy;
+		for (int k = 0; k < P::N; k++) {
+			int j = k0 + k < n ? k0 + k : n - 1;
+			P::set(dcx, k, dcr[j]);
+			P::set(dcy, k, dci[j]);
+		}
+
+		vec dr, di;
+		seriesDelta(series, dcx, dcy, dr, di);
+		if (julia) dcx = dcy = vec{};
+
+		mvec active = mvec{} - 1;
+		mvec count = mvec{} + series.skip;
+		mvec m = mvec{} + series.skip;
+
+		for (int i = series.skip; i < imax; i++) {
+			vec Zrm, Zim;
+			for (int k = 0; k < P::N; k++) {
+				Zrm[k] = Zr[m[k]];
+				Zim[k] = Zi[m[k]];
+			}
+			vec zr = Zrm + dr, zi = Zim + di;
+			vec mod2 = zr*zr + zi*zi;
+
+			active &= Formula::bounded(mod2);
+			if (!P::L::any(active)) break;
+			count -= active;
+
+			mvec rebase = active & ((mod2 < dr*dr + di*di) | (m == last));
+			if (P::L::any(rebase)) {
+				for (int k = 0; k < P::N; k++) rebases += rebase[k] != 0;
+				dr = rebase ? zr : dr;
+				di = rebase ? zi : di;
+				Zrm = rebase ? vec{} : Zrm;
+				Zim = rebase ? vec{} : Zim;
+				m = rebase ? mvec{} : m;
+			}
+
+			Formula::perturb(Zrm, Zim, dr, di, dcx, dcy);
+			m -= active;
+		}
+
+		for (int k = 0; k < P::N && k0 + k < n; k++) {
+			out[k0 + k] = count[k];
+		}
+	}
+
+	return rebases;
+}
+
+template <typename Formula, bool julia, typename T>
+long long blaSpan(const perturbationFrame& frame, const T* dcr, const T* dci, int imax, float* out, int n);
+
+// The vector kernels gather Z from the full orbit, compressed ones go a pixel at a time with their BLA table
+template <typename Formula, bool julia, typename T>
+long long perturbSpan(const perturbationFrame& frame, const T* dcr, const T* dci, int imax, float* out, int n) {
+	if (frame.Zr == NULL) return blaSpan<Formula, julia>(frame, dcr, dci, imax, out, n);
+	if (frame.rebase) return perturbSpanRebased<Formula, julia>(frame, dcr, dci, imax, out, n);
+
+	perturbSpanFixed<Formula, julia>(frame, dcr, dci, imax, out, n);
+	return 0;
+}
+
+// One pixel's escape time from iteration i at orbit position m onwards, using the frame's BLA table to take
+// the longest valid jump from wherever the pixel is on the orbit and falling back to single perturbation steps.
+// Rebases like perturbSpanRebased when the frame asks for it.
+template <typename Formula, bool julia, typename T>
+float blaPixel(const perturbationFrame& frame, T dcx, T dcy, T dr, T di, int i, int m, int imax, long long& rebases) {
+	int last = frame.orbitLength - 1;
+	if (m > last) return glitchedPixel;
+	orbitCursor<Formula> Z(frame, m);
+
+	while (i < imax) {
+		if (Z.m > last) return glitchedPixel;
+
+		T zr = Z.zr + dr, zi = Z.zi + di;
+		T mod2 = zr*zr + zi*zi;
+		if (!Formula::bounded(mod2)) break;
+
+		if (frame.rebase) {
+			if (mod2 < dr*dr + di*di || Z.m == last) {
+				dr = zr;
+				di = zi;
+				Z.to(0);
+				rebases++;
+			}
+		} else if (mod2 < glitchTolerance*(Z.zr*Z.zr + Z.zi*Z.zi)) {
+			return glitchedPixel;
+		}
+
+		if (Z.m > 0 && frame.blaLevels > 0) {
+			// level k has an entry at m when 2^k divides m-1
+			int top = Z.m == 1 ? frame.blaLevels - 1 : __builtin_ctz(Z.m - 1);
+			if (top > frame.blaLevels - 1) top = frame.blaLevels - 1;
+
+			const blaStep* jump = NULL;
+			for (int level = top; level >= 0 && jump == NULL; level--) {
+				int j = frame.blaLevelStart[level] + ((Z.m - 1) >> level);
+				if (j >= frame.blaLevelStart[level+1]) continue;
+
+				const blaStep& b = frame.bla[j];
+				if (dr*dr + di*di < b.r*b.r && Z.m + b.l <= last && i + b.l <= imax) {
+					jump = &b;
+				}
+			}
+
+			if (jump != NULL) {
+				T ndr = jump->ar*dr - jump->ai*di + jump->br*dcx - jump->bi*dcy;
+				di = jump->ar*di + jump->ai*dr + jump->br*dcy + jump->bi*dcx;
+				dr = ndr;
+				Z.to(Z.m + jump->l);
+				i += jump->l;
+				continue;
+			}
+		}
+
+		Formula::perturb(T(Z.zr), T(Z.zi), dr, di, dcx, dcy);
+		Z.step();
+		i++;
+	}
+
+	return i;
+}
+
+// Same escape times one pixel at a time with BLA jumps
+template <typename Formula, bool julia, typename T>
+long long blaSpan(const perturbationFrame& frame, const T* dcr, const T* dci, int imax, float* out, int n) {
+	long long rebases = 0;
+
+	for (int k = 0; k < n; k++) {
+		T dr, di, dcx = julia ? T(0) : dcr[k], dcy = julia ? T(0) : dci[k];
+		seriesDelta(frame.series, dcr[k], dci[k], dr, di);
+		out[k] = blaPixel<Formula, julia>(frame, dcx, dcy, dr, di, frame.series.skip, frame.series.skip, imax, rebases);
+	}
+
+	return rebases;
+}
+
+// Same escape times for frames whose dc is below double range. While dz is that small the pixel's z is Z,
+// or dz itself against Z_0 = 0, so only the delta needs the wide exponent. Once dz is back in double range
+// dc is too small to change it and the pixel carries on in doubles, without BLA since the table is fitted
+// to a double radius.
+template <typename Formula, bool julia, typename T>
+long long perturbSpanExp(const perturbationFrame& frame, const floatExp* dcr, const floatExp* dci, int imax, float* out, int n) {
+	const int64_t doubleRange = -800; // dz exponent from which doubles take over
+
+	int last = frame.orbitLength - 1;
+	perturbationFrame steps = frame;
+	steps.blaLevels = 0;
+	long long rebases = 0;
+	auto tiny = [](const floatExp& x) { return x.m == 0 || x.e < doubleRange; };
+
+	for (int k = 0; k < n; k++) {
+		floatExp dcx = dcr[k], dcy = dci[k];
+		floatExp dr, di;
+		seriesDelta(frame.series, dcx, dcy, dr, di);
+		if (julia) dcx = dcy = floatExp();
+
+		int i = frame.series.skip;
+		bool escaped = false;
+		orbitCursor<Formula> Z(frame, i);
+		while (i < imax && Z.m <= last && tiny(dr) && tiny(di)) {
+			T Zrm = Z.zr, Zim = Z.zi;
+			if (!Formula::bounded(Zrm*Zrm + Zim*Zim)) {
+				escaped = true;
+				break;
+			}
+
+			if (frame.rebase && Z.m == last) {
+				dr = dr + Zrm;
+				di = di + Zim;
+				Zrm = Zim = 0;
+				Z.to(0);
+				rebases++;
+			}
+
+			Formula::perturb(Zrm, Zim, dr, di, dcx, dcy);
+			Z.step();
+			i++;
+		}
+
+		out[k] = escaped || i >= imax ? i : blaPixel<Formula, julia>(steps, T(dcx), T(dcy), T(dr), T(di), i, Z.m, imax, rebases);
+	}
+
+	return rebases;
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+// Kernel headers are compiled once per instruction set, each copy in its own namespace
+#ifndef KERNEL_ISA
+	#define KERNEL_ISA baseline
+#endif
+
+namespace KERNEL_ISA {
+
+// Width of the widest vector register the current translation unit is compiled for, 0 for one lane
+#if defined(KERNEL_SCALAR)
+	const int SIMD_BYTES = 0;
+#elif defined(__AVX512F__)
+	const int SIMD_BYTES = 64;
+#elif defined(__AVX2__)
+	const int SIMD_BYTES = 32;
+#else
+	const int SIMD_BYTES = 16;
+#endif
+
+template <typename T> struct maskOf {};
+template <> struct maskOf<float> { typedef int32_t type; };
+template <> struct maskOf<double> { typedef int64_t type; };
+
+// A register's worth of T, one pixel per lane
+template <typename T>
+struct lanes {
+	static const int BYTES = SIMD_BYTES ? SIMD_BYTES : sizeof(T);
+	static const int N = BYTES / sizeof(T);
+
+	typedef T vec __attribute__((vector_size(BYTES)));
+	typedef typename maskOf<T>::type mvec __attribute__((vector_size(BYTES)));
+
+	static inline vec broadcast(T x) {
+		vec v;
+		for (int k = 0; k < N; k++) v[k] = x;
+		return v;
+	}
+
+	static inline bool any(mvec m) {
+		typename maskOf<T>::type r = 0;
+		for (int k = 0; k < N; k++) r |= m[k];
+		return r != 0;
+	}
+
+	// table[index[k]] in each lane, one gather instruction where the instruction set has it
+	static inline mvec gather(const typename maskOf<T>::type* table, mvec index) {
+#ifdef __AVX512F__
+		if constexpr (sizeof(T) == 4 && BYTES == 64) return (mvec)_mm512_mask_i32gather_epi32(_mm512_setzero_si512(), -1, (__m512i)index, table, 4);
+#endif
+#ifdef __AVX2__
+		if constexpr (sizeof(T) == 4 && BYTES == 32) return (mvec)_mm256_i32gather_epi32((const int*)table, (__m256i)index, 4);
+#endif
+		mvec r;
+		for (int k = 0; k < N; k++) r[k] = table[index[k]];
+		return r;
+	}
+};
+
+}